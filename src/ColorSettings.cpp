@@ -43,6 +43,11 @@ QColor ColorSettings::colorForComposite(int id) const
     }
 }
 
+QVector<QRgb> ColorSettings::colorTable() const
+{
+    return { m_bg.rgb(), m_fg.rgb(), m_ov1.rgb(), m_ov2.rgb(), m_fg.rgb() };
+}
+
 // --- Dialog ---
 
 ColorSettingsDialog::ColorSettingsDialog(ColorSettings *settings, QWidget *parent)
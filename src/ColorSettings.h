@@ -1,6 +1,7 @@
 #pragma once
 #include <QColor>
 #include <QDialog>
+#include <QVector>
 
 class QComboBox;
 
@@ -23,6 +24,11 @@ public:
     // 0=bg, 1=fg, 2=ov1, 3=ov2, 4=fg (overlay color 3)
     QColor colorForComposite(int id) const;
 
+    // Color table indexed by composite pixel id, for Format_Indexed8 views.
+    // Views append their own chrome colors after COMPOSITE_COLORS.
+    static constexpr int COMPOSITE_COLORS = 5;
+    QVector<QRgb> colorTable() const;
+
 signals:
     void colorsChanged();
 
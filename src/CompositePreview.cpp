@@ -1,14 +1,49 @@
 #include "CompositePreview.h"
 #include "ColorSettings.h"
+#include "FontNotifier.h"
 #include <QPainter>
-
-// --- CompositePreview ---
+#include <cstring>
 
 CompositePreview::CompositePreview(QWidget *parent)
     : QWidget(parent)
 {
 }
 
+void CompositePreview::setFont(UlfFont *font)
+{
+    if (m_font && m_font->notifier())
+        disconnect(m_font->notifier(), nullptr, this, nullptr);
+    m_font = font;
+    if (FontNotifier *notifier = m_font ? m_font->notifier() : nullptr) {
+        connect(notifier, &FontNotifier::baseGlyphChanged, this, &CompositePreview::onBaseGlyphChanged);
+        connect(notifier, &FontNotifier::overlayGlyphChanged, this, &CompositePreview::onOverlayGlyphChanged);
+        connect(notifier, &FontNotifier::fontReset, this, QOverload<>::of(&QWidget::update));
+    }
+    update();
+}
+
+void CompositePreview::setColorSettings(ColorSettings *cs)
+{
+    if (m_colorSettings)
+        disconnect(m_colorSettings, nullptr, this, nullptr);
+    m_colorSettings = cs;
+    if (m_colorSettings)
+        connect(m_colorSettings, &ColorSettings::colorsChanged, this, QOverload<>::of(&QWidget::update));
+    update();
+}
+
+void CompositePreview::onBaseGlyphChanged(int glyphIndex)
+{
+    if (m_hasEntry && glyphIndex == m_entry.baseIndex)
+        update();
+}
+
+void CompositePreview::onOverlayGlyphChanged(int glyphIndex)
+{
+    if (m_hasEntry && glyphIndex == m_entry.overlayIndex)
+        update();
+}
+
 void CompositePreview::setEntry(const UnicodeMapEntry &entry)
 {
     m_entry = entry;
@@ -41,13 +76,19 @@ void CompositePreview::paintEvent(QPaintEvent *)
         return;
     }
 
-    for (int y = 0; y < UlfFont::GLYPH_H; ++y) {
-        for (int x = 0; x < UlfFont::GLYPH_W; ++x) {
-            int cid = m_font->compositedPixel(m_entry, x, y);
-            QColor c = m_colorSettings->colorForComposite(cid);
-            p.fillRect(x * m_zoom, y * m_zoom, m_zoom, m_zoom, c);
+    const uint32_t *rows = m_font->cachedComposite(m_entry);
+    if (m_image.isNull() || std::memcmp(rows, m_imageRows, sizeof(m_imageRows)) != 0) {
+        if (m_image.isNull())
+            m_image = QImage(UlfFont::GLYPH_W, UlfFont::GLYPH_H, QImage::Format_Indexed8);
+        for (int y = 0; y < UlfFont::GLYPH_H; ++y) {
+            uchar *line = m_image.scanLine(y);
+            for (int x = 0; x < UlfFont::GLYPH_W; ++x)
+                line[x] = uchar(UlfFont::packedPixel(rows, x, y));
         }
+        std::memcpy(m_imageRows, rows, sizeof(m_imageRows));
     }
+    m_image.setColorTable(m_colorSettings->colorTable());
+    p.drawImage(QRect(0, 0, UlfFont::GLYPH_W * m_zoom, UlfFont::GLYPH_H * m_zoom), m_image);
 
     // Grid lines
     p.setPen(QColor(128, 128, 128, 60));
@@ -56,74 +97,3 @@ void CompositePreview::paintEvent(QPaintEvent *)
     for (int y = 0; y <= UlfFont::GLYPH_H; ++y)
         p.drawLine(0, y * m_zoom, UlfFont::GLYPH_W * m_zoom, y * m_zoom);
 }
-
-// --- TextPreview ---
-
-TextPreview::TextPreview(QWidget *parent)
-    : QWidget(parent)
-{
-    setMinimumHeight(UlfFont::GLYPH_H * m_scale + 4);
-}
-
-void TextPreview::setText(const QString &text)
-{
-    m_text = text;
-    update();
-}
-
-QSize TextPreview::sizeHint() const
-{
-    int w = qMax(200, (int)m_text.length() * UlfFont::GLYPH_W * m_scale + 4);
-    return QSize(w, UlfFont::GLYPH_H * m_scale + 4);
-}
-
-const UnicodeMapEntry *TextPreview::findEntry(uint32_t codepoint) const
-{
-    if (!m_font)
-        return nullptr;
-    for (const auto &block : m_font->unicodeMap) {
-        uint32_t end = block.startCodepoint + (uint32_t)block.entries.size();
-        if (codepoint >= block.startCodepoint && codepoint < end) {
-            return &block.entries[codepoint - block.startCodepoint];
-        }
-    }
-    return nullptr;
-}
-
-void TextPreview::paintEvent(QPaintEvent *)
-{
-    QPainter p(this);
-    p.setRenderHint(QPainter::Antialiasing, false);
-
-    QColor bg = m_colorSettings ? m_colorSettings->bgColor() : Qt::black;
-    p.fillRect(rect(), bg);
-
-    if (!m_font || !m_colorSettings)
-        return;
-
-    int xoff = 2;
-    for (int i = 0; i < m_text.size(); ) {
-        uint32_t cp;
-        if (m_text.at(i).isHighSurrogate() && i + 1 < m_text.size()) {
-            cp = QChar::surrogateToUcs4(m_text.at(i), m_text.at(i + 1));
-            i += 2;
-        } else {
-            cp = m_text.at(i).unicode();
-            i += 1;
-        }
-
-        const UnicodeMapEntry *entry = findEntry(cp);
-        if (entry) {
-            for (int gy = 0; gy < UlfFont::GLYPH_H; ++gy) {
-                for (int gx = 0; gx < UlfFont::GLYPH_W; ++gx) {
-                    int cid = m_font->compositedPixel(*entry, gx, gy);
-                    if (cid != 0) {
-                        QColor c = m_colorSettings->colorForComposite(cid);
-                        p.fillRect(xoff + gx * m_scale, 2 + gy * m_scale, m_scale, m_scale, c);
-                    }
-                }
-            }
-        }
-        xoff += UlfFont::GLYPH_W * m_scale;
-    }
-}
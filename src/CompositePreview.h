@@ -1,4 +1,5 @@
 #pragma once
+#include <QImage>
 #include <QWidget>
 #include "UlfFont.h"
 
@@ -9,8 +10,8 @@ class CompositePreview : public QWidget {
 public:
     explicit CompositePreview(QWidget *parent = nullptr);
 
-    void setFont(UlfFont *font) { m_font = font; }
-    void setColorSettings(ColorSettings *cs) { m_colorSettings = cs; }
+    void setFont(UlfFont *font);
+    void setColorSettings(ColorSettings *cs);
     void setEntry(const UnicodeMapEntry &entry);
     void clearEntry();
 
@@ -20,32 +21,16 @@ protected:
     void paintEvent(QPaintEvent *event) override;
 
 private:
+    void onBaseGlyphChanged(int glyphIndex);
+    void onOverlayGlyphChanged(int glyphIndex);
+
     UlfFont *m_font = nullptr;
     ColorSettings *m_colorSettings = nullptr;
     UnicodeMapEntry m_entry;
     bool m_hasEntry = false;
     int m_zoom = 24;
-};
-
-class TextPreview : public QWidget {
-    Q_OBJECT
-public:
-    explicit TextPreview(QWidget *parent = nullptr);
-
-    void setFont(UlfFont *font) { m_font = font; }
-    void setColorSettings(ColorSettings *cs) { m_colorSettings = cs; }
-    void setText(const QString &text);
-
-    QSize sizeHint() const override;
 
-protected:
-    void paintEvent(QPaintEvent *event) override;
-
-private:
-    const UnicodeMapEntry *findEntry(uint32_t codepoint) const;
-
-    UlfFont *m_font = nullptr;
-    ColorSettings *m_colorSettings = nullptr;
-    QString m_text;
-    int m_scale = 2;
+    // 8x16 color-index image, re-rasterized only when the composite changes
+    QImage m_image;
+    uint32_t m_imageRows[UlfFont::GLYPH_H] = {};
 };
@@ -0,0 +1,578 @@
+#include "EditJournal.h"
+#include "FontNotifier.h"
+#include <QCryptographicHash>
+#include <QFile>
+#include <QTimer>
+#include <cstring>
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Edits are group-committed at most this long after they happen
+constexpr int COMMIT_DELAY_MS = 250;
+
+// Header: magic, version, 3 reserved bytes, fileHash() of the serialized
+// font the records apply to
+constexpr char MAGIC[4] = {'X', '1', '6', 'J'};
+constexpr char VERSION = 2;
+constexpr int HEADER_BYTES = 16;
+
+// Record: type byte, 32-bit payload length, payload, CRC-32 of everything
+// before it. A torn write at the end fails the length or the
+// checksum, and replay stops there.
+constexpr int RECORD_OVERHEAD = 9;
+
+enum RecordType : uint8_t {
+    BaseGlyph = 1,   // u8 glyph, image
+    OverlayGlyph,    // u16 glyph, image
+    InsertBlock,     // u32 block, u32 start, u32 count, entries
+    RemoveBlock,     // u32 block
+    SetBlockStart,   // u32 block, u32 start
+    InsertEntry,     // u32 block, u32 entry, entry
+    RemoveEntry,     // u32 block, u32 entry
+    SetEntry,        // u32 block, u32 entry, entry
+};
+
+// Entries as base index, 16-bit overlay index, flag byte
+constexpr int ENTRY_BYTES = 4;
+
+struct CrcTable {
+    uint32_t entries[256];
+};
+
+constexpr CrcTable makeCrcTable()
+{
+    CrcTable t{};
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; ++k)
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        t.entries[i] = c;
+    }
+    return t;
+}
+
+constexpr CrcTable CRC_TABLE = makeCrcTable();
+
+// CRC-32 (IEEE), so every byte of a record counts
+uint32_t checksum(const char *data, int size)
+{
+    uint32_t crc = 0xFFFFFFFFu;
+    for (int i = 0; i < size; ++i)
+        crc = CRC_TABLE.entries[(crc ^ uint8_t(data[i])) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+void appendU16(QByteArray &out, uint32_t value)
+{
+    out += char(value & 0xFF);
+    out += char((value >> 8) & 0xFF);
+}
+
+void appendU32(QByteArray &out, uint32_t value)
+{
+    appendU16(out, value & 0xFFFF);
+    appendU16(out, value >> 16);
+}
+
+void appendEntry(QByteArray &out, const UnicodeMapEntry &entry)
+{
+    out += char(entry.baseIndex);
+    appendU16(out, entry.overlayIndex);
+    out += char((entry.reverse ? 1 : 0) | (entry.noGlyph ? 2 : 0)
+                | (entry.vflip ? 4 : 0) | (entry.hflip ? 8 : 0));
+}
+
+uint32_t readU16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+uint32_t readU32(const uint8_t *p)
+{
+    return readU16(p) | (readU16(p + 2) << 16);
+}
+
+UnicodeMapEntry readEntry(const uint8_t *p)
+{
+    UnicodeMapEntry entry;
+    entry.baseIndex = p[0];
+    entry.overlayIndex = (uint16_t)readU16(p + 1);
+    entry.reverse = p[3] & 1;
+    entry.noGlyph = p[3] & 2;
+    entry.vflip = p[3] & 4;
+    entry.hflip = p[3] & 8;
+    return entry;
+}
+
+// Appends one record to out: construct, write the payload, then finish()
+class RecordWriter {
+public:
+    RecordWriter(QByteArray &out, RecordType type) : m_out(out), m_start(out.size())
+    {
+        m_out += char(type);
+        appendU32(m_out, 0);
+    }
+
+    void finish()
+    {
+        uint32_t length = (uint32_t)(m_out.size() - m_start - 5);
+        for (int i = 0; i < 4; ++i)
+            m_out[m_start + 1 + i] = char((length >> (8 * i)) & 0xFF);
+        appendU32(m_out, checksum(m_out.constData() + m_start, (int)(m_out.size() - m_start)));
+    }
+
+private:
+    QByteArray &m_out;
+    int m_start;
+};
+
+uint64_t baseHash(const UlfFont &font)
+{
+    return EditJournal::fileHash(font.serialize());
+}
+
+QByteArray makeHeader(uint64_t hash)
+{
+    QByteArray header(MAGIC, 4);
+    header += VERSION;
+    header.append(3, 0);
+    appendU32(header, (uint32_t)hash);
+    appendU32(header, (uint32_t)(hash >> 32));
+    return header;
+}
+
+bool applyRecord(UlfFont &font, int type, const uint8_t *p, uint32_t length)
+{
+    const auto &map = font.unicodeMap;
+    uint32_t block = length >= 4 ? readU32(p) : 0;
+    switch (type) {
+    case BaseGlyph:
+        if (length != 1 + UlfFont::BASE_GLYPH_BYTES)
+            return false;
+        font.setBaseGlyph(p[0], p + 1);
+        return true;
+    case OverlayGlyph:
+        if (length != 2 + UlfFont::OVERLAY_GLYPH_BYTES || readU16(p) >= UlfFont::OVERLAY_COUNT)
+            return false;
+        font.setOverlayGlyph((int)readU16(p), p + 2);
+        return true;
+    case InsertBlock: {
+        if (length < 12 || block > map.size())
+            return false;
+        UnicodeMapBlock newBlock;
+        newBlock.startCodepoint = readU32(p + 4);
+        uint32_t count = readU32(p + 8);
+        if (length != 12 + count * ENTRY_BYTES)
+            return false;
+        newBlock.entries.resize(count);
+        for (uint32_t i = 0; i < count; ++i)
+            newBlock.entries[i] = readEntry(p + 12 + i * ENTRY_BYTES);
+        font.insertBlock((int)block, newBlock);
+        return true;
+    }
+    case RemoveBlock:
+        if (length != 4 || block >= map.size())
+            return false;
+        font.removeBlock((int)block);
+        return true;
+    case SetBlockStart:
+        if (length != 8 || block >= map.size())
+            return false;
+        font.setBlockStart((int)block, readU32(p + 4));
+        return true;
+    case InsertEntry:
+    case SetEntry: {
+        if (length != 8 + ENTRY_BYTES || block >= map.size())
+            return false;
+        uint32_t entry = readU32(p + 4);
+        size_t count = map[block].entries.size();
+        if (type == InsertEntry ? entry > count : entry >= count)
+            return false;
+        if (type == InsertEntry)
+            font.insertEntry((int)block, (int)entry, readEntry(p + 8));
+        else
+            font.setEntry((int)block, (int)entry, readEntry(p + 8));
+        return true;
+    }
+    case RemoveEntry:
+        if (length != 8 || block >= map.size() || readU32(p + 4) >= map[block].entries.size())
+            return false;
+        font.removeEntry((int)block, (int)readU32(p + 4));
+        return true;
+    }
+    return false;
+}
+
+} // namespace
+
+EditJournal::EditJournal(UlfFont *font, QObject *parent)
+    : QObject(parent), m_font(font)
+{
+    if (FontNotifier *notifier = m_font->notifier()) {
+        connect(notifier, &FontNotifier::baseGlyphChanged, this, &EditJournal::onBaseGlyphChanged);
+        connect(notifier, &FontNotifier::overlayGlyphChanged, this, &EditJournal::onOverlayGlyphChanged);
+        connect(notifier, &FontNotifier::blockInserted, this, &EditJournal::onBlockInserted);
+        connect(notifier, &FontNotifier::blockRemoved, this, &EditJournal::onBlockRemoved);
+        connect(notifier, &FontNotifier::blockStartChanged, this, &EditJournal::onBlockStartChanged);
+        connect(notifier, &FontNotifier::entryInserted, this, &EditJournal::onEntryInserted);
+        connect(notifier, &FontNotifier::entryRemoved, this, &EditJournal::onEntryRemoved);
+        connect(notifier, &FontNotifier::entryChanged, this, &EditJournal::onEntryChanged);
+        connect(notifier, &FontNotifier::fontReset, this, &EditJournal::onFontReset);
+    }
+
+    m_commitTimer = new QTimer(this);
+    m_commitTimer->setSingleShot(true);
+    m_commitTimer->setInterval(COMMIT_DELAY_MS);
+    connect(m_commitTimer, &QTimer::timeout, this, &EditJournal::commit);
+
+    m_thread.setObjectName(QStringLiteral("EditJournal"));
+    m_worker = new QObject;
+    m_worker->moveToThread(&m_thread);
+    connect(&m_thread, &QThread::finished, m_worker, &QObject::deleteLater);
+    m_thread.start();
+}
+
+EditJournal::~EditJournal()
+{
+    // The font may be gone by now, so pending edits are the owner's to
+    // commit(). What was written stays on disk; a clean close discarded it.
+    QMetaObject::invokeMethod(m_worker, [this]() { closeFile(false); }, Qt::BlockingQueuedConnection);
+    m_thread.quit();
+    m_thread.wait();
+}
+
+uint64_t EditJournal::fileHash(const QByteArray &image)
+{
+    QByteArray digest = QCryptographicHash::hash(image, QCryptographicHash::Sha256);
+    return readU32(reinterpret_cast<const uint8_t *>(digest.constData()))
+        | (uint64_t(readU32(reinterpret_cast<const uint8_t *>(digest.constData()) + 4)) << 32);
+}
+
+QString EditJournal::journalPath(const QString &fontPath)
+{
+    return fontPath + QStringLiteral(".journal");
+}
+
+EditJournal::Recovery EditJournal::check(const QString &fontPath, const UlfFont &base)
+{
+    Recovery recovery;
+    QFile file(journalPath(fontPath));
+    if (!file.open(QIODevice::ReadOnly))
+        return recovery;
+    QByteArray data = file.readAll();
+    const auto *bytes = reinterpret_cast<const uint8_t *>(data.constData());
+    if (data.size() < HEADER_BYTES || std::memcmp(bytes, MAGIC, 4) != 0 || bytes[4] != VERSION)
+        return recovery;
+    uint64_t hash = readU32(bytes + 8) | (uint64_t(readU32(bytes + 12)) << 32);
+    if (hash != baseHash(base))
+        return recovery;
+
+    qint64 pos = HEADER_BYTES;
+    while (data.size() - pos >= RECORD_OVERHEAD) {
+        uint32_t length = readU32(bytes + pos + 1);
+        qint64 end = pos + 5 + length;
+        if (length > (uint32_t)(data.size() - pos - RECORD_OVERHEAD)
+            || readU32(bytes + end) != checksum(data.constData() + pos, (int)(end - pos)))
+            break;
+        pos = end + 4;
+        ++recovery.records;
+    }
+    recovery.validBytes = pos;
+    data.truncate(pos);
+    recovery.data = data;
+    return recovery;
+}
+
+qint64 EditJournal::replay(const Recovery &recovery, UlfFont &font)
+{
+    const auto *bytes = reinterpret_cast<const uint8_t *>(recovery.data.constData());
+    qint64 pos = HEADER_BYTES;
+    for (int i = 0; i < recovery.records; ++i) {
+        uint32_t length = readU32(bytes + pos + 1);
+        if (!applyRecord(font, bytes[pos], bytes + pos + 5, length))
+            break;
+        pos += RECORD_OVERHEAD + length;
+    }
+    return pos;
+}
+
+void EditJournal::start(const QString &fontPath, qint64 replayedBytes)
+{
+    clearPending();
+    m_saving = false;
+    m_sinceSave.clear();
+    if (replayedBytes > 0)
+        openJournal(fontPath, QByteArray(), replayedBytes);
+    else
+        openJournal(fontPath, makeHeader(baseHash(*m_font)), 0);
+}
+
+void EditJournal::beginSave()
+{
+    // What's pending predates the snapshot and belongs in the current journal
+    commit();
+    m_saving = true;
+    m_sinceSave.clear();
+    // An untitled font has no journal yet, but the saved file will
+    m_active = true;
+}
+
+void EditJournal::endSave(const QString &fontPath, uint64_t hash)
+{
+    if (!m_saving)
+        return;
+    commit();
+    QByteArray contents = makeHeader(hash) + m_sinceSave;
+    m_saving = false;
+    m_sinceSave.clear();
+    openJournal(fontPath, contents, 0);
+}
+
+void EditJournal::abortSave()
+{
+    if (!m_saving)
+        return;
+    m_saving = false;
+    m_sinceSave.clear();
+    m_active = !m_path.isEmpty();
+    if (!m_active)
+        clearPending();
+}
+
+void EditJournal::openJournal(const QString &fontPath, const QByteArray &contents, qint64 keepBytes)
+{
+    m_path = journalPath(fontPath);
+    m_active = true;
+    QString path = m_path;
+    QMetaObject::invokeMethod(m_worker, [this, path, contents, keepBytes]() {
+        openFile(path, contents, keepBytes);
+    }, Qt::QueuedConnection);
+}
+
+void EditJournal::discard()
+{
+    clearPending();
+    m_active = false;
+    m_saving = false;
+    m_sinceSave.clear();
+    m_path.clear();
+    QMetaObject::invokeMethod(m_worker, [this]() { closeFile(true); }, Qt::BlockingQueuedConnection);
+}
+
+void EditJournal::commit()
+{
+    m_commitTimer->stop();
+    if (!m_active)
+        return;
+
+    QByteArray batch;
+    for (int i = 0; i < UlfFont::BASE_COUNT; ++i) {
+        if (!m_dirtyBase[i])
+            continue;
+        RecordWriter record(batch, BaseGlyph);
+        batch += char(i);
+        batch.append(reinterpret_cast<const char *>(m_font->baseGlyphs[i]), UlfFont::BASE_GLYPH_BYTES);
+        record.finish();
+    }
+    for (int i = 0; i < UlfFont::OVERLAY_COUNT; ++i) {
+        if (!m_dirtyOverlay[i])
+            continue;
+        RecordWriter record(batch, OverlayGlyph);
+        appendU16(batch, i);
+        batch.append(reinterpret_cast<const char *>(m_font->overlayGlyphs[i]), UlfFont::OVERLAY_GLYPH_BYTES);
+        record.finish();
+    }
+    batch += m_pending;
+    clearPending();
+    if (m_saving)
+        m_sinceSave += batch;
+
+    if (!batch.isEmpty())
+        QMetaObject::invokeMethod(m_worker, [this, batch]() { append(batch); }, Qt::QueuedConnection);
+}
+
+void EditJournal::scheduleCommit()
+{
+    if (!m_commitTimer->isActive())
+        m_commitTimer->start();
+}
+
+void EditJournal::clearPending()
+{
+    m_pending.clear();
+    m_dirtyBase.reset();
+    m_dirtyOverlay.reset();
+}
+
+void EditJournal::onBaseGlyphChanged(int glyphIndex)
+{
+    if (!m_active)
+        return;
+    m_dirtyBase.set(glyphIndex);
+    scheduleCommit();
+}
+
+void EditJournal::onOverlayGlyphChanged(int glyphIndex)
+{
+    if (!m_active)
+        return;
+    m_dirtyOverlay.set(glyphIndex);
+    scheduleCommit();
+}
+
+void EditJournal::onBlockInserted(int blockIndex)
+{
+    if (!m_active)
+        return;
+    const auto &block = m_font->unicodeMap[blockIndex];
+    RecordWriter record(m_pending, InsertBlock);
+    appendU32(m_pending, blockIndex);
+    appendU32(m_pending, block.startCodepoint);
+    appendU32(m_pending, (uint32_t)block.entries.size());
+    for (const auto &entry : block.entries)
+        appendEntry(m_pending, entry);
+    record.finish();
+    scheduleCommit();
+}
+
+void EditJournal::onBlockRemoved(int blockIndex)
+{
+    if (!m_active)
+        return;
+    RecordWriter record(m_pending, RemoveBlock);
+    appendU32(m_pending, blockIndex);
+    record.finish();
+    scheduleCommit();
+}
+
+void EditJournal::onBlockStartChanged(int blockIndex)
+{
+    if (!m_active)
+        return;
+    RecordWriter record(m_pending, SetBlockStart);
+    appendU32(m_pending, blockIndex);
+    appendU32(m_pending, m_font->unicodeMap[blockIndex].startCodepoint);
+    record.finish();
+    scheduleCommit();
+}
+
+void EditJournal::onEntryInserted(int blockIndex, int entryIndex)
+{
+    if (!m_active)
+        return;
+    RecordWriter record(m_pending, InsertEntry);
+    appendU32(m_pending, blockIndex);
+    appendU32(m_pending, entryIndex);
+    appendEntry(m_pending, m_font->unicodeMap[blockIndex].entries[entryIndex]);
+    record.finish();
+    scheduleCommit();
+}
+
+void EditJournal::onEntryRemoved(int blockIndex, int entryIndex)
+{
+    if (!m_active)
+        return;
+    RecordWriter record(m_pending, RemoveEntry);
+    appendU32(m_pending, blockIndex);
+    appendU32(m_pending, entryIndex);
+    record.finish();
+    scheduleCommit();
+}
+
+void EditJournal::onEntryChanged(int blockIndex, int entryIndex)
+{
+    if (!m_active)
+        return;
+    RecordWriter record(m_pending, SetEntry);
+    appendU32(m_pending, blockIndex);
+    appendU32(m_pending, entryIndex);
+    appendEntry(m_pending, m_font->unicodeMap[blockIndex].entries[entryIndex]);
+    record.finish();
+    scheduleCommit();
+}
+
+void EditJournal::onFontReset()
+{
+    // The records no longer apply to what the font holds; the owner starts
+    // a new journal (or discards this one) once it knows the new file
+    clearPending();
+    m_active = false;
+    m_saving = false;
+    m_sinceSave.clear();
+}
+
+void EditJournal::onFailed(const QString &path)
+{
+    // A save or open may have moved on to another journal meanwhile
+    if (path != m_path)
+        return;
+    clearPending();
+    m_active = false;
+    m_saving = false;
+    m_sinceSave.clear();
+    m_path.clear();
+    emit failed(path);
+}
+
+void EditJournal::openFile(const QString &path, const QByteArray &contents, qint64 keepBytes)
+{
+    // After Save As the old file's journal has nothing left to recover
+    closeFile(m_file && m_file->fileName() != path);
+    m_file = new QFile(path);
+    if (!m_file->open(QIODevice::ReadWrite)) {
+        failFile();
+        return;
+    }
+    if (keepBytes > 0) {
+        // Continue after the records replay() applied, dropping whatever
+        // followed them: a torn record, or ones that didn't fit the font
+        if (!m_file->resize(keepBytes) || !m_file->seek(keepBytes))
+            failFile();
+        return;
+    }
+    if (!m_file->resize(0)) {
+        failFile();
+        return;
+    }
+    append(contents);
+}
+
+void EditJournal::append(const QByteArray &bytes)
+{
+    if (!m_file || !m_file->isOpen())
+        return;
+    bool ok = m_file->write(bytes) == bytes.size() && m_file->flush();
+#ifdef Q_OS_WIN
+    ok = ok && _commit(m_file->handle()) == 0;
+#else
+    ok = ok && fsync(m_file->handle()) == 0;
+#endif
+    if (!ok)
+        failFile();
+}
+
+void EditJournal::closeFile(bool remove)
+{
+    if (!m_file)
+        return;
+    m_file->close();
+    if (remove)
+        m_file->remove();
+    delete m_file;
+    m_file = nullptr;
+}
+
+void EditJournal::failFile()
+{
+    // The file is closed but kept, so appends are dropped and a later
+    // discard still deletes it; check() cuts off a torn record at the end
+    QString path = m_file->fileName();
+    qWarning("EditJournal: can't write %s: %s", qPrintable(path), qPrintable(m_file->errorString()));
+    m_file->close();
+    QMetaObject::invokeMethod(this, [this, path]() { onFailed(path); }, Qt::QueuedConnection);
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+#include <QThread>
+#include <bitset>
+#include "UlfFont.h"
+
+class QFile;
+class QTimer;
+
+// Append-only log of edits to the open font, kept next to it as
+// "<font>.journal" until the font is saved or closed cleanly. Edits are
+// picked up from the font notifier, batched in memory and group-committed
+// by a worker thread, so painting never waits on the disk. After a crash
+// the journal is replayed onto the file it was started against.
+class EditJournal : public QObject {
+    Q_OBJECT
+public:
+    // A journal found next to a font, checked against the font's contents
+    struct Recovery {
+        int records = 0;        // complete records that apply to the font
+        qint64 validBytes = 0;  // header plus those records
+        QByteArray data;
+    };
+
+    explicit EditJournal(UlfFont *font, QObject *parent = nullptr);
+    ~EditJournal() override;
+
+    static QString journalPath(const QString &fontPath);
+    // Identifies the file image a journal applies to (64 bits of its SHA-256)
+    static uint64_t fileHash(const QByteArray &image);
+    // The journal for fontPath, if it was started against exactly base
+    static Recovery check(const QString &fontPath, const UlfFont &base);
+    // Applies the recovery's records in order, stopping at the first one
+    // that doesn't fit the font. Returns the journal bytes up to there
+    // (header included); less than validBytes if records were dropped.
+    static qint64 replay(const Recovery &recovery, UlfFont &font);
+
+    // Journal edits from now on against the font's current contents, as
+    // saved at fontPath; or, given the bytes replay() applied, carry on
+    // after them with the rest of the old journal cut off
+    void start(const QString &fontPath, qint64 replayedBytes = 0);
+    // A background save of the font's current contents is starting. Edits
+    // from here on are kept aside too, to begin the journal that goes with
+    // the saved file: endSave() switches to it once the file is on disk
+    // (hash being that of the bytes written), abortSave() if the save failed.
+    void beginSave();
+    void endSave(const QString &fontPath, uint64_t hash);
+    void abortSave();
+    // Stop recording and delete the journal; waits for the worker
+    void discard();
+    // Hand pending records to the worker now. The owner calls this before
+    // the font goes away; the destructor doesn't touch the font.
+    void commit();
+
+signals:
+    // The journal at path couldn't be opened or written. Edits aren't
+    // journaled from then on, until the next save or start().
+    void failed(const QString &path);
+
+private:
+    void onBaseGlyphChanged(int glyphIndex);
+    void onOverlayGlyphChanged(int glyphIndex);
+    void onBlockInserted(int blockIndex);
+    void onBlockRemoved(int blockIndex);
+    void onBlockStartChanged(int blockIndex);
+    void onEntryInserted(int blockIndex, int entryIndex);
+    void onEntryRemoved(int blockIndex, int entryIndex);
+    void onEntryChanged(int blockIndex, int entryIndex);
+    void onFontReset();
+    void onFailed(const QString &path);
+
+    void scheduleCommit();
+    void clearPending();
+    void openJournal(const QString &fontPath, const QByteArray &contents, qint64 keepBytes);
+
+    // Worker thread
+    void openFile(const QString &path, const QByteArray &contents, qint64 keepBytes);
+    void append(const QByteArray &bytes);
+    void closeFile(bool remove);
+    void failFile();
+
+    UlfFont *m_font;
+    bool m_active = false;
+    QString m_path;  // journal file while active
+
+    // Map records in edit order; glyphs are written as their latest image
+    // at commit time, so a stroke costs one record per glyph
+    QByteArray m_pending;
+    std::bitset<UlfFont::BASE_COUNT> m_dirtyBase;
+    std::bitset<UlfFont::OVERLAY_COUNT> m_dirtyOverlay;
+    QTimer *m_commitTimer;
+    bool m_saving = false;
+    QByteArray m_sinceSave;  // records committed since beginSave()
+
+    QThread m_thread;
+    QObject *m_worker = nullptr;  // lives on m_thread; context for file writes
+    QFile *m_file = nullptr;  // worker thread only; closed after a write error
+};
@@ -0,0 +1,94 @@
+#include "FontLoader.h"
+#include "UlfFont.h"
+#include "UlfFontView.h"
+#include <QFile>
+
+// Bytes read between progress reports and cancellation checks
+static constexpr qint64 READ_CHUNK = 256 * 1024;
+
+FontLoader::FontLoader(QObject *parent)
+    : QObject(parent)
+{
+    m_thread.setObjectName(QStringLiteral("FontLoader"));
+    m_worker = new QObject;
+    m_worker->moveToThread(&m_thread);
+    connect(&m_thread, &QThread::finished, m_worker, &QObject::deleteLater);
+    m_thread.start();
+}
+
+FontLoader::~FontLoader()
+{
+    ++m_loadId;
+    m_thread.quit();
+    m_thread.wait();
+}
+
+void FontLoader::load(const QString &path)
+{
+    int loadId = ++m_loadId;
+    m_loading = true;
+    QMetaObject::invokeMethod(m_worker, [this, loadId, path]() { run(loadId, path); },
+                              Qt::QueuedConnection);
+}
+
+void FontLoader::cancel()
+{
+    ++m_loadId;
+    m_loading = false;
+}
+
+void FontLoader::run(int loadId, const QString &path)
+{
+    // Results are posted back and dropped there if the load was cancelled
+    // or superseded in the meantime
+    auto finish = [this, loadId, path](std::shared_ptr<UlfFont> font) {
+        QMetaObject::invokeMethod(this, [this, loadId, path, font]() {
+            if (cancelled(loadId))
+                return;
+            m_loading = false;
+            emit finished(path, font);
+        }, Qt::QueuedConnection);
+    };
+    if (cancelled(loadId))
+        return;
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        finish(nullptr);
+        return;
+    }
+
+    qint64 total = file.size();
+    QByteArray data(total, Qt::Uninitialized);
+    qint64 done = 0;
+    int reported = -1;
+    while (done < total) {
+        qint64 n = file.read(data.data() + done, qMin(READ_CHUNK, total - done));
+        if (n < 0) {
+            finish(nullptr);
+            return;
+        }
+        if (n == 0)
+            break;  // file shrank while reading; parse what's there
+        done += n;
+        if (cancelled(loadId))
+            return;
+
+        int percent = (int)(done * 100 / total);
+        if (percent != reported) {
+            reported = percent;
+            QMetaObject::invokeMethod(this, [this, loadId, done, total]() {
+                if (!cancelled(loadId))
+                    emit progress(done, total);
+            }, Qt::QueuedConnection);
+        }
+    }
+    data.truncate(done);
+
+    UlfFontView view;
+    auto font = std::make_shared<UlfFont>();
+    if (!view.openData(data) || !font->loadFromView(view))
+        font.reset();
+    if (!cancelled(loadId))
+        finish(font);
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <QObject>
+#include <QString>
+#include <QThread>
+#include <atomic>
+#include <memory>
+
+class UlfFont;
+
+// Loads .ulf files on a worker thread. The file is read in chunks, so a slow
+// share reports progress and can be cancelled between chunks; parsing and
+// indexing happen there too, and the UI thread only has to UlfFont::adopt()
+// the finished font.
+class FontLoader : public QObject {
+    Q_OBJECT
+public:
+    explicit FontLoader(QObject *parent = nullptr);
+    ~FontLoader() override;
+
+    // Starts loading path; a load still running is cancelled
+    void load(const QString &path);
+    void cancel();
+    bool isLoading() const { return m_loading; }
+
+signals:
+    void progress(qint64 bytesRead, qint64 bytesTotal);
+    // font is null if the file couldn't be read or isn't a font
+    void finished(const QString &path, std::shared_ptr<UlfFont> font);
+
+private:
+    // Worker thread
+    void run(int loadId, const QString &path);
+    bool cancelled(int loadId) const { return m_loadId != loadId; }
+
+    std::atomic<int> m_loadId{0};
+    bool m_loading = false;  // UI thread
+
+    QThread m_thread;
+    QObject *m_worker = nullptr;  // lives on m_thread; context for run()
+};
@@ -0,0 +1,6 @@
+#include "FontNotifier.h"
+
+FontNotifier::FontNotifier(QObject *parent)
+    : QObject(parent)
+{
+}
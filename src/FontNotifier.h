@@ -0,0 +1,35 @@
+#pragma once
+#include <QObject>
+#include <cstdint>
+
+// Change events for one UlfFont. The font's mutators emit these once the
+// data has changed, so undo/redo, direct edits and loads all look the same
+// to the views. Palette changes come from ColorSettings::colorsChanged.
+class FontNotifier : public QObject {
+    Q_OBJECT
+public:
+    explicit FontNotifier(QObject *parent = nullptr);
+
+signals:
+    void baseGlyphChanged(int glyphIndex);
+    void overlayGlyphChanged(int glyphIndex);
+
+    // Map structure, with indexes as they are after the change
+    void blockInserted(int blockIndex);
+    void blockRemoved(int blockIndex);
+    void blockStartChanged(int blockIndex);
+    void entryInserted(int blockIndex, int entryIndex);
+    void entryRemoved(int blockIndex, int entryIndex);
+    void entryChanged(int blockIndex, int entryIndex);
+
+    // Codepoints (inclusive) whose lookup may have a new answer
+    void mapRangeChanged(uint32_t first, uint32_t last);
+
+    // Everything changed: cleared or loaded
+    void fontReset();
+
+    // An undo command couldn't read back the data it kept in the
+    // HistoryStore and left the font as it was, so the rest of the undo
+    // history no longer matches the font
+    void historyLost(const QString &commandText);
+};
@@ -0,0 +1,52 @@
+#include "FontSaver.h"
+#include "EditJournal.h"
+#include "UlfFont.h"
+#include "UlfFontSnapshot.h"
+#include <QCoreApplication>
+
+FontSaver::FontSaver(QObject *parent)
+    : QObject(parent)
+{
+    m_thread.setObjectName(QStringLiteral("FontSaver"));
+    m_worker = new QObject;
+    m_worker->moveToThread(&m_thread);
+    connect(&m_thread, &QThread::finished, m_worker, &QObject::deleteLater);
+    m_thread.start();
+}
+
+FontSaver::~FontSaver()
+{
+    // Unlike a load, a save that was started is never dropped
+    QMetaObject::invokeMethod(m_worker, []() {}, Qt::BlockingQueuedConnection);
+    m_thread.quit();
+    m_thread.wait();
+}
+
+void FontSaver::save(const QString &path, const UlfFontSnapshot &snapshot)
+{
+    ++m_pending;
+    QMetaObject::invokeMethod(m_worker, [this, path, snapshot]() { run(path, snapshot); },
+                              Qt::QueuedConnection);
+}
+
+void FontSaver::waitForFinished()
+{
+    if (m_pending == 0)
+        return;
+    // The worker runs in order, so once this returns every save is written;
+    // then deliver their results, which were posted to us
+    QMetaObject::invokeMethod(m_worker, []() {}, Qt::BlockingQueuedConnection);
+    QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
+}
+
+void FontSaver::run(const QString &path, const UlfFontSnapshot &snapshot)
+{
+    QByteArray data = snapshot.serialize();
+    uint64_t hash = EditJournal::fileHash(data);
+    bool ok = UlfFont::writeFile(path, data);
+    uint64_t version = snapshot.version();
+    QMetaObject::invokeMethod(this, [this, path, version, hash, ok]() {
+        --m_pending;
+        emit finished(path, version, hash, ok);
+    }, Qt::QueuedConnection);
+}
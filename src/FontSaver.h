@@ -0,0 +1,37 @@
+#pragma once
+#include <QObject>
+#include <QString>
+#include <QThread>
+#include <cstdint>
+
+class UlfFontSnapshot;
+
+// Saves fonts on a worker thread. The UI thread only takes a snapshot, which
+// shares the font's pages and blocks, so editing carries on while the file is
+// serialized and written (and a slow share is waited on). Saves run in the
+// order they were started.
+class FontSaver : public QObject {
+    Q_OBJECT
+public:
+    explicit FontSaver(QObject *parent = nullptr);
+    ~FontSaver() override;
+
+    void save(const QString &path, const UlfFontSnapshot &snapshot);
+    bool isSaving() const { return m_pending > 0; }
+    // Blocks until every save started so far is done and reported
+    void waitForFinished();
+
+signals:
+    // version is the snapshot's; hash is EditJournal::fileHash() of the bytes
+    // written, as the file now holds them
+    void finished(const QString &path, uint64_t version, uint64_t hash, bool ok);
+
+private:
+    // Worker thread
+    void run(const QString &path, const UlfFontSnapshot &snapshot);
+
+    int m_pending = 0;  // UI thread
+
+    QThread m_thread;
+    QObject *m_worker = nullptr;  // lives on m_thread; context for run()
+};
@@ -0,0 +1,136 @@
+#include "GlyphDedup.h"
+#include "GlyphTransform.h"
+#include <array>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+// The slot kept for a glyph's class, and the variant of the kept glyph that
+// the slot holds. Variants combine by XOR: bit 0 is an invert (base) or a
+// horizontal flip (overlay), bit 1 a vertical flip.
+struct Match {
+    int slot;
+    int variant;
+};
+
+// Slots in use are visited first, so the slot kept for a class is the lowest
+// one the map uses; a second pass then finds nothing to do even though the
+// cleared slots are now copies of each other
+template <int Bytes, int Variants, typename Glyph, typename Used, typename Vary>
+std::vector<Match> classify(int count, Glyph glyph, Used used, Vary vary)
+{
+    using Image = std::array<uint8_t, Bytes>;
+    std::vector<Match> matches(count);
+    std::vector<Image> canonical(count);
+    std::vector<int> canonicalVariant(count);
+    std::unordered_multimap<uint64_t, int> kept;  // canonical hash -> kept slot
+    kept.reserve(count);
+
+    std::vector<int> order;
+    order.reserve(count);
+    for (int i = 0; i < count; ++i)
+        if (used(i))
+            order.push_back(i);
+    for (int i = 0; i < count; ++i)
+        if (!used(i))
+            order.push_back(i);
+
+    for (int i : order) {
+        // The lexicographically smallest variant is the same for the whole class
+        Image variants[Variants];
+        vary(glyph(i), variants);
+        int best = 0;
+        for (int v = 1; v < Variants; ++v)
+            if (variants[v] < variants[best])
+                best = v;
+        canonical[i] = variants[best];
+        canonicalVariant[i] = best;
+
+        uint64_t hash = UlfFont::hashGlyph(canonical[i].data(), Bytes);
+        matches[i] = {i, 0};
+        auto range = kept.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (canonical[it->second] == canonical[i]) {
+                // var[best](i) == var[keptBest](kept), so i == var[best ^ keptBest](kept)
+                matches[i] = {it->second, best ^ canonicalVariant[it->second]};
+                break;
+            }
+        }
+        if (matches[i].slot == i)
+            kept.emplace(hash, i);
+    }
+    return matches;
+}
+
+} // namespace
+
+GlyphDedup::Plan GlyphDedup::plan(const UlfFont *font)
+{
+    constexpr int BASE_BYTES = UlfFont::BASE_GLYPH_BYTES;
+    constexpr int OVERLAY_BYTES = UlfFont::OVERLAY_GLYPH_BYTES;
+
+    auto base = classify<BASE_BYTES, 2>(UlfFont::BASE_COUNT,
+        [font](int i) { return font->baseGlyphs[i]; },
+        [font](int i) { return !font->baseGlyphUsers(i).empty(); },
+        [](const uint8_t *glyph, std::array<uint8_t, BASE_BYTES> *out) {
+            std::memcpy(out[0].data(), glyph, BASE_BYTES);
+            out[1] = out[0];
+            GlyphTransform::transformBase(GlyphTransform::Invert, out[1].data());
+        });
+    auto overlay = classify<OVERLAY_BYTES, 4>(UlfFont::OVERLAY_COUNT,
+        [font](int i) { return font->overlayGlyphs[i]; },
+        [font](int i) { return !font->overlayGlyphUsers(i).empty(); },
+        [](const uint8_t *glyph, std::array<uint8_t, OVERLAY_BYTES> *out) {
+            std::memcpy(out[0].data(), glyph, OVERLAY_BYTES);
+            out[1] = out[0];
+            GlyphTransform::transformOverlay(GlyphTransform::MirrorHorizontal, out[1].data());
+            out[2] = out[0];
+            GlyphTransform::transformOverlay(GlyphTransform::MirrorVertical, out[2].data());
+            out[3] = out[1];
+            GlyphTransform::transformOverlay(GlyphTransform::MirrorVertical, out[3].data());
+        });
+
+    // A merged slot is one the map stops using or that gets cleared; blank
+    // unused copies are already as free as they get
+    Plan plan;
+    auto merge = [&plan, font](GlyphEditCommand::Layer layer, int slot, bool used) {
+        GlyphEditCommand::GlyphDelta delta = GlyphEditCommand::capture(font, layer, slot);
+        std::memset(delta.after, 0, sizeof(delta.after));
+        if (!delta.isNoOp())
+            plan.clearedGlyphs.push_back(delta);
+        return used || !delta.isNoOp();
+    };
+    for (int i = 0; i < UlfFont::BASE_COUNT; ++i)
+        if (base[i].slot != i && merge(GlyphEditCommand::Base, i, !font->baseGlyphUsers(i).empty()))
+            ++plan.baseMerged;
+    for (int i = 0; i < UlfFont::OVERLAY_COUNT; ++i)
+        if (overlay[i].slot != i && merge(GlyphEditCommand::Overlay, i, !font->overlayGlyphUsers(i).empty()))
+            ++plan.overlayMerged;
+    if (plan.isEmpty())
+        return plan;
+
+    // The entry shows var[f](kept) through its flags E, the same as kept
+    // through E ^ f: flags and variants are both XOR combinations
+    const UnicodeMap &map = font->unicodeMap;
+    for (int b = 0; b < (int)map.size(); ++b) {
+        const auto &entries = map[b].entries;
+        for (int e = 0; e < (int)entries.size(); ++e) {
+            UnicodeMapEntry entry = entries[e];
+            const Match &baseMatch = base[entry.baseIndex];
+            entry.baseIndex = (uint8_t)baseMatch.slot;
+            entry.reverse ^= (baseMatch.variant & 1) != 0;
+            if (entry.overlayIndex < UlfFont::OVERLAY_COUNT) {
+                const Match &overlayMatch = overlay[entry.overlayIndex];
+                entry.overlayIndex = (uint16_t)overlayMatch.slot;
+                entry.hflip ^= (overlayMatch.variant & 1) != 0;
+                entry.vflip ^= (overlayMatch.variant & 2) != 0;
+            }
+            const UnicodeMapEntry &old = entries[e];
+            if (entry.baseIndex != old.baseIndex || entry.overlayIndex != old.overlayIndex
+                || entry.reverse != old.reverse || entry.hflip != old.hflip || entry.vflip != old.vflip)
+                plan.entries.push_back({b, e, entry});
+        }
+    }
+    return plan;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <vector>
+#include "UndoCommands.h"
+
+// Finds glyph slots that show the same thing as another slot once map entry
+// flags are taken into account: overlays that are horizontal and/or vertical
+// flips of each other (hflip/vflip), and base glyphs that are inversions of
+// each other (reverse). Each glyph is hashed in a canonical orientation, so
+// the equivalence classes come out of one pass over the slots. The lowest
+// slot of a class that the map uses is kept (the lowest slot if it uses none),
+// the map is pointed at it with the flags adjusted, and the other slots are
+// cleared for reuse.
+class GlyphDedup {
+public:
+    struct EntryEdit {
+        int blockIndex;
+        int entryIndex;
+        UnicodeMapEntry entry;
+    };
+
+    struct Plan {
+        int baseMerged = 0;     // slots folded into another
+        int overlayMerged = 0;
+        std::vector<EntryEdit> entries;
+        std::vector<GlyphEditCommand::GlyphDelta> clearedGlyphs;
+
+        bool isEmpty() const { return baseMerged == 0 && overlayMerged == 0; }
+    };
+
+    static Plan plan(const UlfFont *font);
+};
@@ -1,7 +1,7 @@
 #include "GlyphEditor.h"
 #include "UlfFont.h"
+#include "FontNotifier.h"
 #include "ColorSettings.h"
-#include "UndoCommands.h"
 #include <QPainter>
 #include <QMouseEvent>
 #include <QUndoStack>
@@ -12,12 +12,80 @@ GlyphEditor::GlyphEditor(QWidget *parent)
     setMouseTracking(true);
 }
 
+void GlyphEditor::setFont(UlfFont *font)
+{
+    if (m_font && m_font->notifier())
+        disconnect(m_font->notifier(), nullptr, this, nullptr);
+    m_font = font;
+    if (FontNotifier *notifier = m_font ? m_font->notifier() : nullptr) {
+        connect(notifier, &FontNotifier::baseGlyphChanged, this, [this](int index) {
+            onGlyphChanged(Base1bpp, index);
+        });
+        connect(notifier, &FontNotifier::overlayGlyphChanged, this, [this](int index) {
+            onGlyphChanged(Overlay2bpp, index);
+        });
+        connect(notifier, &FontNotifier::fontReset, this, [this]() {
+            // The glyph under a stroke is gone, and so is the stack it was for
+            m_dragging = false;
+            update();
+        });
+    }
+    update();
+}
+
+void GlyphEditor::setUndoStack(QUndoStack *stack)
+{
+    if (m_undoStack)
+        disconnect(m_undoStack, nullptr, this, nullptr);
+    m_undoStack = stack;
+    if (m_undoStack)
+        connect(m_undoStack, &QUndoStack::indexChanged, this, &GlyphEditor::onUndoIndexChanged);
+}
+
+void GlyphEditor::setColorSettings(ColorSettings *cs)
+{
+    if (m_colorSettings)
+        disconnect(m_colorSettings, nullptr, this, nullptr);
+    m_colorSettings = cs;
+    if (m_colorSettings)
+        connect(m_colorSettings, &ColorSettings::colorsChanged, this, QOverload<>::of(&QWidget::update));
+    update();
+}
+
+void GlyphEditor::onGlyphChanged(Mode mode, int glyphIndex)
+{
+    if (mode == m_mode && glyphIndex == m_glyphIndex)
+        update();
+}
+
 void GlyphEditor::setGlyphIndex(int index)
 {
+    // A stroke records one glyph: the part already painted becomes its own
+    // undo step, and the drag carries on as a new stroke on this glyph
+    if (m_dragging && index != m_glyphIndex) {
+        m_dragging = false;  // the push isn't an undo/redo ending the drag
+        finishStroke();
+        m_glyphIndex = index;
+        beginStroke();
+        m_dragging = true;
+    }
     m_glyphIndex = index;
     update();
 }
 
+void GlyphEditor::onUndoIndexChanged()
+{
+    if (!m_dragging)
+        return;
+    // Undo or redo mid-drag ends the stroke. If it rewrote the glyph being
+    // painted, that image replaced the stroke's pixels, and the stroke has
+    // nothing left to record. The stack is done with the command it undid
+    // or redid by the time it signals, so pushing from here is safe.
+    m_dragging = false;
+    if (m_font && glyphGeneration() == m_strokeGeneration)
+        finishStroke();
+}
+
 void GlyphEditor::setZoom(int z)
 {
     m_zoom = qBound(8, z, 48);
@@ -31,36 +99,49 @@ QSize GlyphEditor::sizeHint() const
     return QSize(UlfFont::GLYPH_W * m_zoom + 1, UlfFont::GLYPH_H * m_zoom + 1);
 }
 
-void GlyphEditor::paintEvent(QPaintEvent *)
+uint64_t GlyphEditor::glyphGeneration() const
 {
-    if (!m_font || !m_colorSettings)
-        return;
+    return m_mode == Base1bpp ? m_font->baseGeneration(m_glyphIndex)
+                              : m_font->overlayGeneration(m_glyphIndex);
+}
 
-    QPainter p(this);
-    p.setRenderHint(QPainter::Antialiasing, false);
+void GlyphEditor::rasterize()
+{
+    if (m_image.isNull())
+        m_image = QImage(UlfFont::GLYPH_W, UlfFont::GLYPH_H, QImage::Format_Indexed8);
 
     for (int y = 0; y < UlfFont::GLYPH_H; ++y) {
+        uchar *line = m_image.scanLine(y);
         for (int x = 0; x < UlfFont::GLYPH_W; ++x) {
-            QRect cell(x * m_zoom, y * m_zoom, m_zoom, m_zoom);
-
+            // Same ids as the composite: base 0/1, overlay 1-3 -> 2-4
             if (m_mode == Base1bpp) {
-                int px = m_font->basePixel(m_glyphIndex, x, y);
-                p.fillRect(cell, px ? m_colorSettings->fgColor() : m_colorSettings->bgColor());
+                line[x] = uchar(m_font->basePixel(m_glyphIndex, x, y));
             } else {
                 int px = m_font->overlayPixel(m_glyphIndex, x, y);
-                if (px == 0) {
-                    p.fillRect(cell, m_colorSettings->bgColor());
-                } else if (px == 1) {
-                    p.fillRect(cell, m_colorSettings->overlayColor1());
-                } else if (px == 2) {
-                    p.fillRect(cell, m_colorSettings->overlayColor2());
-                } else {
-                    p.fillRect(cell, m_colorSettings->fgColor());
-                }
+                line[x] = uchar(px ? px + 1 : 0);
             }
         }
     }
 
+    m_imageMode = m_mode;
+    m_imageGlyph = m_glyphIndex;
+    m_imageGeneration = glyphGeneration();
+}
+
+void GlyphEditor::paintEvent(QPaintEvent *)
+{
+    if (!m_font || !m_colorSettings)
+        return;
+
+    if (m_image.isNull() || m_imageMode != m_mode || m_imageGlyph != m_glyphIndex ||
+        m_imageGeneration != glyphGeneration())
+        rasterize();
+    m_image.setColorTable(m_colorSettings->colorTable());
+
+    QPainter p(this);
+    p.setRenderHint(QPainter::Antialiasing, false);
+    p.drawImage(QRect(0, 0, UlfFont::GLYPH_W * m_zoom, UlfFont::GLYPH_H * m_zoom), m_image);
+
     // Grid lines
     p.setPen(QColor(128, 128, 128, 80));
     for (int x = 0; x <= UlfFont::GLYPH_W; ++x)
@@ -81,23 +162,39 @@ void GlyphEditor::paintPixel(int x, int y)
     if (x < 0 || x >= UlfFont::GLYPH_W || y < 0 || y >= UlfFont::GLYPH_H)
         return;
 
+    // Pixels go straight into the font; the stroke becomes one undo command
+    // with the glyph's before/after image when the button is released
     if (m_mode == Base1bpp) {
-        int oldVal = m_font->basePixel(m_glyphIndex, x, y);
-        if (oldVal != m_activeColor) {
-            m_undoStack->push(new SetPixelCommand(
-                m_font, SetPixelCommand::Base, m_glyphIndex, x, y, m_activeColor));
-            emit glyphModified();
-            update();
-        }
+        if (m_font->basePixel(m_glyphIndex, x, y) == m_activeColor)
+            return;
+        m_font->setBasePixel(m_glyphIndex, x, y, m_activeColor);
     } else {
-        int oldVal = m_font->overlayPixel(m_glyphIndex, x, y);
-        if (oldVal != m_activeColor) {
-            m_undoStack->push(new SetPixelCommand(
-                m_font, SetPixelCommand::Overlay, m_glyphIndex, x, y, m_activeColor));
-            emit glyphModified();
-            update();
-        }
+        if (m_font->overlayPixel(m_glyphIndex, x, y) == m_activeColor)
+            return;
+        m_font->setOverlayPixel(m_glyphIndex, x, y, m_activeColor);
     }
+    m_strokeGeneration = glyphGeneration();
+    emit glyphModified(m_glyphIndex);
+}
+
+void GlyphEditor::beginStroke()
+{
+    if (!m_font)
+        return;
+    m_stroke = GlyphEditCommand::capture(m_font,
+        m_mode == Base1bpp ? GlyphEditCommand::Base : GlyphEditCommand::Overlay, m_glyphIndex);
+    m_strokeGeneration = glyphGeneration();
+}
+
+void GlyphEditor::finishStroke()
+{
+    if (!m_font || !m_undoStack)
+        return;
+    GlyphEditCommand::captureAfter(m_font, m_stroke);
+    if (m_stroke.isNoOp())
+        return;
+    m_undoStack->push(new GlyphEditCommand(m_font,
+        m_mode == Base1bpp ? tr("Paint base pixels") : tr("Paint overlay pixels"), { m_stroke }));
 }
 
 void GlyphEditor::mousePressEvent(QMouseEvent *event)
@@ -105,8 +202,7 @@ void GlyphEditor::mousePressEvent(QMouseEvent *event)
     if (event->button() == Qt::LeftButton || event->button() == Qt::RightButton) {
         m_activeColor = (event->button() == Qt::LeftButton) ? m_drawColor : m_eraseColor;
         m_dragging = true;
-        if (m_undoStack)
-            m_undoStack->beginMacro(m_mode == Base1bpp ? "Paint base pixels" : "Paint overlay pixels");
+        beginStroke();
         QPoint px = pixelAt(event->pos());
         paintPixel(px.x(), px.y());
     }
@@ -124,7 +220,6 @@ void GlyphEditor::mouseReleaseEvent(QMouseEvent *event)
 {
     if ((event->button() == Qt::LeftButton || event->button() == Qt::RightButton) && m_dragging) {
         m_dragging = false;
-        if (m_undoStack)
-            m_undoStack->endMacro();
+        finishStroke();
     }
 }
@@ -1,7 +1,8 @@
 #pragma once
+#include <QImage>
 #include <QWidget>
+#include "UndoCommands.h"
 
-class UlfFont;
 class ColorSettings;
 class QUndoStack;
 
@@ -12,9 +13,9 @@ public:
 
     explicit GlyphEditor(QWidget *parent = nullptr);
 
-    void setFont(UlfFont *font) { m_font = font; }
-    void setColorSettings(ColorSettings *cs) { m_colorSettings = cs; }
-    void setUndoStack(QUndoStack *stack) { m_undoStack = stack; }
+    void setFont(UlfFont *font);
+    void setColorSettings(ColorSettings *cs);
+    void setUndoStack(QUndoStack *stack);
     void setMode(Mode mode) { m_mode = mode; update(); }
     void setGlyphIndex(int index);
     void setDrawColor(int color) { m_drawColor = color; }
@@ -26,7 +27,7 @@ public:
     QSize sizeHint() const override;
 
 signals:
-    void glyphModified();
+    void glyphModified(int glyphIndex);
 
 protected:
     void paintEvent(QPaintEvent *event) override;
@@ -35,8 +36,14 @@ protected:
     void mouseReleaseEvent(QMouseEvent *event) override;
 
 private:
+    void beginStroke();
     void paintPixel(int x, int y);
+    void finishStroke();
+    void onGlyphChanged(Mode mode, int glyphIndex);
+    void onUndoIndexChanged();
     QPoint pixelAt(const QPoint &pos) const;
+    uint64_t glyphGeneration() const;
+    void rasterize();
 
     UlfFont *m_font = nullptr;
     ColorSettings *m_colorSettings = nullptr;
@@ -48,4 +55,12 @@ private:
     int m_activeColor = 1;
     int m_zoom = 24;
     bool m_dragging = false;
+    GlyphEditCommand::GlyphDelta m_stroke;
+    uint64_t m_strokeGeneration = 0;  // the glyph's, as the stroke last left it
+
+    // 8x16 color-index image of the glyph, rescaled by the painter
+    QImage m_image;
+    Mode m_imageMode = Base1bpp;
+    int m_imageGlyph = -1;
+    uint64_t m_imageGeneration = 0;
 };
@@ -1,18 +1,67 @@
 #include "GlyphGrid.h"
 #include "UlfFont.h"
+#include "FontNotifier.h"
 #include "ColorSettings.h"
+#include "UnicodeInfo.h"
 #include <QPainter>
+#include <QPaintEvent>
 #include <QMouseEvent>
+#include <QHelpEvent>
+#include <QToolTip>
+#include <algorithm>
+#include <limits>
+
+static constexpr uint64_t DIRTY_CELL = std::numeric_limits<uint64_t>::max();
+
+// Chrome entries appended to the shared composite color table
+static constexpr uchar BORDER_INDEX = ColorSettings::COMPOSITE_COLORS;
+static constexpr uchar GRID_LINE_INDEX = ColorSettings::COMPOSITE_COLORS + 1;
 
 GlyphGrid::GlyphGrid(QWidget *parent)
     : QWidget(parent)
 {
 }
 
+void GlyphGrid::setFont(UlfFont *font)
+{
+    if (m_font && m_font->notifier())
+        disconnect(m_font->notifier(), nullptr, this, nullptr);
+    m_font = font;
+    if (FontNotifier *notifier = m_font ? m_font->notifier() : nullptr) {
+        connect(notifier, &FontNotifier::baseGlyphChanged, this, [this](int index) {
+            if (m_layer == BaseLayer)
+                markGlyphDirty(index);
+        });
+        connect(notifier, &FontNotifier::overlayGlyphChanged, this, [this](int index) {
+            if (m_layer == OverlayLayer)
+                markGlyphDirty(index);
+        });
+        connect(notifier, &FontNotifier::fontReset, this, &GlyphGrid::refreshAll);
+        // Usage counts are drawn over the atlas, so no cell needs re-rendering
+        connect(notifier, &FontNotifier::mapRangeChanged, this, [this]() {
+            if (m_showUsage)
+                update();
+        });
+    }
+    refreshAll();
+}
+
+void GlyphGrid::setColorSettings(ColorSettings *cs)
+{
+    if (m_colorSettings)
+        disconnect(m_colorSettings, nullptr, this, nullptr);
+    m_colorSettings = cs;
+    // Only the color table changes; no cell is re-rendered
+    if (m_colorSettings)
+        connect(m_colorSettings, &ColorSettings::colorsChanged, this, QOverload<>::of(&QWidget::update));
+    update();
+}
+
 void GlyphGrid::setLayer(Layer layer)
 {
     m_layer = layer;
     m_selected = 0;
+    m_rangeEnd = 0;
     updateGeometry();
     update();
 }
@@ -20,12 +69,81 @@ void GlyphGrid::setLayer(Layer layer)
 void GlyphGrid::setSelectedIndex(int index)
 {
     if (index >= 0 && index < glyphCount() && index != m_selected) {
-        m_selected = index;
-        update();
+        if (m_rangeEnd != m_selected)
+            update();
+        update(cellRect(m_selected));
+        m_selected = m_rangeEnd = index;
+        update(cellRect(m_selected));
         emit glyphSelected(m_selected);
     }
 }
 
+void GlyphGrid::refreshAll()
+{
+    std::fill(m_cellGenerations.begin(), m_cellGenerations.end(), DIRTY_CELL);
+    update();
+}
+
+void GlyphGrid::markGlyphDirty(int index)
+{
+    if (index < 0 || index >= (int)m_cellGenerations.size())
+        return;
+    m_cellGenerations[index] = DIRTY_CELL;
+    update(cellRect(index));
+}
+
+void GlyphGrid::setShowUsage(bool show)
+{
+    if (m_showUsage != show) {
+        m_showUsage = show;
+        update();
+    }
+}
+
+const std::vector<uint32_t> &GlyphGrid::glyphUsers(int index) const
+{
+    return m_layer == BaseLayer ? m_font->baseGlyphUsers(index) : m_font->overlayGlyphUsers(index);
+}
+
+QString GlyphGrid::usageToolTip(int index) const
+{
+    static constexpr int MAX_LISTED = 16;
+
+    QString text = m_layer == BaseLayer
+        ? tr("Base glyph %1 (0x%2)").arg(index).arg(index, 2, 16, QChar('0'))
+        : tr("Overlay glyph %1 (0x%2)").arg(index).arg(index, 3, 16, QChar('0'));
+
+    const auto &users = glyphUsers(index);
+    if (users.empty())
+        return text + "\n" + tr("Not used by any codepoint");
+
+    text += "\n" + tr("Used by %n codepoint(s):", "", (int)users.size());
+    for (int i = 0; i < (int)users.size() && i < MAX_LISTED; ++i) {
+        uint32_t cp = users[i];
+        text += "\n" + unicodeCodepointStr(cp);
+        QString ch = unicodeCharStr(cp);
+        if (!ch.isEmpty())
+            text += "  " + ch;
+    }
+    if ((int)users.size() > MAX_LISTED)
+        text += "\n" + tr("…and %1 more").arg(users.size() - MAX_LISTED);
+    return text;
+}
+
+bool GlyphGrid::event(QEvent *event)
+{
+    if (event->type() == QEvent::ToolTip && m_font) {
+        auto *help = static_cast<QHelpEvent *>(event);
+        int idx = glyphAtPos(help->pos());
+        if (idx >= 0)
+            QToolTip::showText(help->globalPos(), usageToolTip(idx), this, cellRect(idx));
+        else
+            QToolTip::hideText();
+        return true;
+    }
+    return QWidget::event(event);
+}
+
 void GlyphGrid::setColumns(int cols)
 {
     m_columns = qMax(1, cols);
@@ -53,6 +171,16 @@ QSize GlyphGrid::minimumSizeHint() const
     return QSize(columns() * cellW(), 100);
 }
 
+QRect GlyphGrid::cellRect(int index) const
+{
+    return QRect((index % columns()) * cellW(), (index / columns()) * cellH(), cellW(), cellH());
+}
+
+uint64_t GlyphGrid::glyphGeneration(int index) const
+{
+    return m_layer == BaseLayer ? m_font->baseGeneration(index) : m_font->overlayGeneration(index);
+}
+
 int GlyphGrid::glyphAtPos(const QPoint &pos) const
 {
     int col = pos.x() / cellW();
@@ -63,86 +191,137 @@ int GlyphGrid::glyphAtPos(const QPoint &pos) const
     return (idx >= 0 && idx < glyphCount()) ? idx : -1;
 }
 
-void GlyphGrid::paintEvent(QPaintEvent *)
+void GlyphGrid::ensureAtlas()
+{
+    QSize size(columns() * cellW(), rows() * cellH());
+    if (m_atlas.size() != size || (int)m_cellGenerations.size() != glyphCount()) {
+        m_atlas = QImage(size, QImage::Format_Indexed8);
+        m_atlas.fill(BORDER_INDEX);
+        m_cellGenerations.assign(glyphCount(), DIRTY_CELL);
+    }
+
+    QVector<QRgb> table = m_colorSettings->colorTable();
+    table << qRgb(48, 48, 48) << qRgb(64, 64, 64);
+    if (m_atlas.colorTable() != table)
+        m_atlas.setColorTable(table);
+}
+
+void GlyphGrid::renderCell(int index)
+{
+    QRect cell = cellRect(index);
+    for (int y = 0; y < cell.height(); ++y) {
+        uchar *line = m_atlas.scanLine(cell.y() + y) + cell.x();
+        if (y == 0) {
+            std::fill(line, line + cell.width(), GRID_LINE_INDEX);
+            continue;
+        }
+        line[0] = GRID_LINE_INDEX;
+        std::fill(line + 1, line + cell.width(), uchar(0));
+
+        // Each glyph pixel is 2x2, offset by the 1px border
+        int gy = (y - 1) / 2;
+        if (gy >= UlfFont::GLYPH_H)
+            continue;
+        for (int gx = 0; gx < UlfFont::GLYPH_W; ++gx) {
+            // Same ids as the composite: base 0/1, overlay 1-3 -> 2-4
+            int px;
+            if (m_layer == BaseLayer) {
+                px = m_font->basePixel(index, gx, gy);
+            } else {
+                px = m_font->overlayPixel(index, gx, gy);
+                if (px)
+                    px += 1;
+            }
+            line[1 + gx * 2] = uchar(px);
+            line[2 + gx * 2] = uchar(px);
+        }
+    }
+
+    m_cellGenerations[index] = glyphGeneration(index);
+}
+
+void GlyphGrid::paintEvent(QPaintEvent *event)
 {
     if (!m_font || !m_colorSettings)
         return;
 
+    ensureAtlas();
+
+    // Only cells inside the exposed area are brought up to date
+    QRect exposed = event->rect() & m_atlas.rect();
+    if (exposed.isEmpty())
+        return;
+    int firstCol = exposed.left() / cellW();
+    int lastCol = qMin(columns() - 1, exposed.right() / cellW());
+    int firstRow = exposed.top() / cellH();
+    int lastRow = qMin(rows() - 1, exposed.bottom() / cellH());
+    for (int row = firstRow; row <= lastRow; ++row) {
+        for (int col = firstCol; col <= lastCol; ++col) {
+            int idx = row * columns() + col;
+            if (idx < glyphCount() && m_cellGenerations[idx] != glyphGeneration(idx))
+                renderCell(idx);
+        }
+    }
+
+    // The atlas is in logical pixels; nearest-neighbour scaling keeps it crisp
+    // on HiDPI. Only the exposed part is drawn, straight from the atlas.
     QPainter p(this);
-    p.setRenderHint(QPainter::Antialiasing, false);
-
-    // Paint at device pixels for crisp 1:1 rendering on HiDPI
-    qreal dpr = devicePixelRatioF();
-    QPixmap pm(QSize(columns() * cellW(), rows() * cellH()) * dpr);
-    pm.setDevicePixelRatio(dpr);
-    pm.fill(QColor(48, 48, 48));
-
-    QPainter pp(&pm);
-    pp.setRenderHint(QPainter::Antialiasing, false);
-
-    int cw = cellW();
-    int ch = cellH();
-
-    QColor bg = m_colorSettings->bgColor();
-    QColor fg = m_colorSettings->fgColor();
-
-    for (int idx = 0; idx < glyphCount(); ++idx) {
-        int col = idx % columns();
-        int row = idx / columns();
-        int cx = col * cw;
-        int cy = row * ch;
-
-        // Background fill for cell interior
-        pp.fillRect(cx, cy, cw, ch, bg);
-
-        // Draw each glyph pixel as exactly 1x1, offset by 1px border
-        for (int gy = 0; gy < UlfFont::GLYPH_H; ++gy) {
-            for (int gx = 0; gx < UlfFont::GLYPH_W; ++gx) {
-                int px;
-                if (m_layer == BaseLayer)
-                    px = m_font->basePixel(idx, gx, gy);
-                else
-                    px = m_font->overlayPixel(idx, gx, gy);
-
-                if (px > 0) {
-                    QColor c;
-                    if (m_layer == BaseLayer) {
-                        c = fg;
-                    } else {
-                        if (px == 1) c = m_colorSettings->overlayColor1();
-                        else if (px == 2) c = m_colorSettings->overlayColor2();
-                        else c = fg;
-                    }
-                    pp.fillRect(cx + 1 + gx * 2, cy + 1 + gy * 2, 2, 2, c);
+    p.setRenderHint(QPainter::SmoothPixmapTransform, false);
+    p.drawImage(exposed, m_atlas, exposed);
+
+    if (m_showUsage) {
+        QFont countFont = font();
+        countFont.setPixelSize(8);
+        p.setFont(countFont);
+        for (int row = firstRow; row <= lastRow; ++row) {
+            for (int col = firstCol; col <= lastCol; ++col) {
+                int idx = row * columns() + col;
+                if (idx >= glyphCount())
+                    continue;
+                QRect cell = cellRect(idx).adjusted(1, 1, 0, 0);
+                int count = (int)glyphUsers(idx).size();
+                if (count == 0) {
+                    p.fillRect(cell, QColor(0, 0, 0, 140));
+                    continue;
                 }
+                QString label = count > 99 ? QStringLiteral("99+") : QString::number(count);
+                QRect badge(cell.left(), cell.bottom() - 9, cell.width(), 10);
+                p.fillRect(badge, QColor(0, 0, 0, 160));
+                p.setPen(QColor(255, 220, 0));
+                p.drawText(badge, Qt::AlignCenter, label);
             }
         }
+    }
 
-        // Selection highlight
-        if (idx == m_selected) {
-            pp.setPen(QPen(QColor(0, 120, 215), 1));
-            pp.drawRect(cx, cy, cw - 1, ch - 1);
+    // Selection highlight
+    for (int row = firstRow; row <= lastRow && rangeFirst() != rangeLast(); ++row) {
+        for (int col = firstCol; col <= lastCol; ++col) {
+            int idx = row * columns() + col;
+            if (idx >= rangeFirst() && idx <= rangeLast())
+                p.fillRect(cellRect(idx), QColor(0, 120, 215, 70));
         }
     }
-
-    // Grid lines
-    pp.setPen(QColor(64, 64, 64));
-    for (int c = 0; c <= columns(); ++c)
-        pp.drawLine(c * cw, 0, c * cw, rows() * ch);
-    for (int r = 0; r <= rows(); ++r)
-        pp.drawLine(0, r * ch, columns() * cw, r * ch);
-
-    pp.end();
-    p.drawPixmap(0, 0, pm);
+    QRect sel = cellRect(m_selected);
+    if (sel.intersects(exposed)) {
+        p.setPen(QPen(QColor(0, 120, 215), 1));
+        p.drawRect(sel.adjusted(0, 0, -1, -1));
+    }
 }
 
 void GlyphGrid::mousePressEvent(QMouseEvent *event)
 {
     if (event->button() == Qt::LeftButton) {
         int idx = glyphAtPos(event->pos());
-        if (idx >= 0) {
-            m_selected = idx;
+        if (idx >= 0 && (event->modifiers() & Qt::ShiftModifier)) {
+            // The selected glyph stays put, so no map entry is reassigned
+            m_rangeEnd = idx;
             update();
+        } else if (idx >= 0) {
+            if (m_rangeEnd != m_selected)
+                update();
+            update(cellRect(m_selected));
+            m_selected = m_rangeEnd = idx;
+            update(cellRect(m_selected));
             emit glyphSelected(m_selected);
         }
     }
@@ -1,5 +1,7 @@
 #pragma once
+#include <QImage>
 #include <QWidget>
+#include <vector>
 
 class UlfFont;
 class ColorSettings;
@@ -11,13 +13,22 @@ public:
 
     explicit GlyphGrid(QWidget *parent = nullptr);
 
-    void setFont(UlfFont *font) { m_font = font; }
-    void setColorSettings(ColorSettings *cs) { m_colorSettings = cs; }
+    void setFont(UlfFont *font);
+    void setColorSettings(ColorSettings *cs);
     void setLayer(Layer layer);
     void setColumns(int cols);
     void setSelectedIndex(int index);
     int selectedIndex() const { return m_selected; }
-    void refreshAll() { update(); }
+    // Shift-click extends a range from the selected glyph; inclusive, and
+    // just the selected glyph when there is none
+    int rangeFirst() const { return qMin(m_selected, m_rangeEnd); }
+    int rangeLast() const { return qMax(m_selected, m_rangeEnd); }
+    void refreshAll();
+    void markGlyphDirty(int index);
+
+    // Draw each glyph's map usage count over its cell and dim unused glyphs
+    void setShowUsage(bool show);
+    bool showUsage() const { return m_showUsage; }
 
     QSize sizeHint() const override;
     QSize minimumSizeHint() const override;
@@ -26,11 +37,18 @@ signals:
     void glyphSelected(int index);
 
 protected:
+    bool event(QEvent *event) override;
     void paintEvent(QPaintEvent *event) override;
     void mousePressEvent(QMouseEvent *event) override;
 
 private:
     int glyphAtPos(const QPoint &pos) const;
+    QRect cellRect(int index) const;
+    uint64_t glyphGeneration(int index) const;
+    void ensureAtlas();
+    void renderCell(int index);
+    const std::vector<uint32_t> &glyphUsers(int index) const;
+    QString usageToolTip(int index) const;
     int columns() const { return m_columns; }
     int rows() const;
     int glyphCount() const;
@@ -41,5 +59,13 @@ private:
     ColorSettings *m_colorSettings = nullptr;
     Layer m_layer = BaseLayer;
     int m_selected = 0;
+    int m_rangeEnd = 0;
     int m_columns = 16;
+    bool m_showUsage = false;
+
+    // Persistent indexed rendering of every cell; a cell is re-rendered only
+    // when its glyph generation no longer matches the one it was drawn from.
+    // Colors live in the color table, so palette changes never re-render.
+    QImage m_atlas;
+    std::vector<uint64_t> m_cellGenerations;
 };
@@ -0,0 +1,288 @@
+#include "GlyphTransform.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace {
+
+constexpr int H = UlfFont::GLYPH_H;
+// First row of the square that quarter turns keep
+constexpr int SQUARE_TOP = (UlfFont::GLYPH_H - UlfFont::GLYPH_W) / 2;
+
+// One 1bpp plane: a byte per row, bit 7 is the leftmost pixel
+using Plane = std::array<uint8_t, H>;
+
+struct Tables {
+    uint8_t reverse[256];   // bits in reverse order
+    uint16_t spread[256];   // bit i moved to bit 2i
+    uint8_t gather[256];    // even bits 0,2,4,6 packed into bits 0-3
+};
+
+constexpr Tables makeTables()
+{
+    Tables t{};
+    for (int b = 0; b < 256; ++b) {
+        for (int i = 0; i < 8; ++i) {
+            if (b & (1 << i)) {
+                t.reverse[b] |= uint8_t(1 << (7 - i));
+                t.spread[b] |= uint16_t(1 << (2 * i));
+            }
+        }
+        for (int i = 0; i < 4; ++i)
+            if (b & (1 << (2 * i)))
+                t.gather[b] |= uint8_t(1 << i);
+    }
+    return t;
+}
+
+constexpr Tables TABLES = makeTables();
+
+// Overlay rows are two bytes of four 2bpp pixels each, MSB first
+void splitOverlay(const uint8_t *glyph, Plane &high, Plane &low)
+{
+    for (int y = 0; y < H; ++y) {
+        uint8_t left = glyph[y * 2], right = glyph[y * 2 + 1];
+        high[y] = uint8_t(TABLES.gather[left >> 1] << 4 | TABLES.gather[right >> 1]);
+        low[y] = uint8_t(TABLES.gather[left] << 4 | TABLES.gather[right]);
+    }
+}
+
+void joinOverlay(const Plane &high, const Plane &low, uint8_t *glyph)
+{
+    for (int y = 0; y < H; ++y) {
+        uint16_t row = uint16_t(TABLES.spread[high[y]] << 1 | TABLES.spread[low[y]]);
+        glyph[y * 2] = uint8_t(row >> 8);
+        glyph[y * 2 + 1] = uint8_t(row);
+    }
+}
+
+// 8x8 bit matrix transpose, one row per byte with row 0 in the top byte
+uint64_t transpose8(uint64_t x)
+{
+    uint64_t t;
+    t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAull;
+    x ^= t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCull;
+    x ^= t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ull;
+    x ^= t ^ (t << 28);
+    return x;
+}
+
+void rotate(Plane &p, bool clockwise)
+{
+    uint64_t square = 0;
+    for (int i = 0; i < 8; ++i)
+        square |= uint64_t(p[SQUARE_TOP + i]) << (8 * (7 - i));
+    square = transpose8(square);
+
+    // Transposing then mirroring horizontally turns clockwise, transposing
+    // then mirroring vertically turns counterclockwise
+    p.fill(0);
+    for (int i = 0; i < 8; ++i) {
+        uint8_t row = uint8_t(square >> (8 * (7 - i)));
+        if (clockwise)
+            p[SQUARE_TOP + i] = TABLES.reverse[row];
+        else
+            p[SQUARE_TOP + 7 - i] = row;
+    }
+}
+
+// Pixels set in the plane or any of their 8 neighbours
+Plane dilate(const Plane &p)
+{
+    Plane wide, out;
+    for (int y = 0; y < H; ++y)
+        wide[y] = uint8_t(p[y] | p[y] << 1 | p[y] >> 1);
+    for (int y = 0; y < H; ++y)
+        out[y] = uint8_t(wide[y] | (y > 0 ? wide[y - 1] : 0) | (y < H - 1 ? wide[y + 1] : 0));
+    return out;
+}
+
+// Transforms that move pixels without looking at their values
+void transformPlane(GlyphTransform::Operation op, Plane &p)
+{
+    switch (op) {
+    case GlyphTransform::ShiftLeft:
+        for (uint8_t &row : p)
+            row = uint8_t(row << 1);
+        break;
+    case GlyphTransform::ShiftRight:
+        for (uint8_t &row : p)
+            row >>= 1;
+        break;
+    case GlyphTransform::ShiftUp:
+        std::copy(p.begin() + 1, p.end(), p.begin());
+        p[H - 1] = 0;
+        break;
+    case GlyphTransform::ShiftDown:
+        std::copy_backward(p.begin(), p.end() - 1, p.end());
+        p[0] = 0;
+        break;
+    case GlyphTransform::MirrorHorizontal:
+        for (uint8_t &row : p)
+            row = TABLES.reverse[row];
+        break;
+    case GlyphTransform::MirrorVertical:
+        std::reverse(p.begin(), p.end());
+        break;
+    case GlyphTransform::RotateClockwise:
+    case GlyphTransform::RotateCounterClockwise:
+        rotate(p, op == GlyphTransform::RotateClockwise);
+        break;
+    default:
+        break;
+    }
+}
+
+#ifndef QT_NO_DEBUG
+// Per-pixel statement of each operation, which the row kernels must match.
+// maxValue is the layer's largest pixel value (the outline color).
+int referencePixel(GlyphTransform::Operation op, int (*pixel)(const uint8_t *, int, int),
+                   const uint8_t *glyph, int x, int y, int maxValue)
+{
+    switch (op) {
+    case GlyphTransform::ShiftLeft:
+        return pixel(glyph, x + 1, y);
+    case GlyphTransform::ShiftRight:
+        return pixel(glyph, x - 1, y);
+    case GlyphTransform::ShiftUp:
+        return pixel(glyph, x, y + 1);
+    case GlyphTransform::ShiftDown:
+        return pixel(glyph, x, y - 1);
+    case GlyphTransform::MirrorHorizontal:
+        return pixel(glyph, UlfFont::GLYPH_W - 1 - x, y);
+    case GlyphTransform::MirrorVertical:
+        return pixel(glyph, x, H - 1 - y);
+    case GlyphTransform::RotateClockwise:
+        if (y < SQUARE_TOP || y >= SQUARE_TOP + 8)
+            return 0;
+        return pixel(glyph, y - SQUARE_TOP, SQUARE_TOP + 7 - x);
+    case GlyphTransform::RotateCounterClockwise:
+        if (y < SQUARE_TOP || y >= SQUARE_TOP + 8)
+            return 0;
+        return pixel(glyph, SQUARE_TOP + 7 - y, SQUARE_TOP + x);
+    case GlyphTransform::Invert:
+        return maxValue - pixel(glyph, x, y);
+    case GlyphTransform::Embolden: {
+        int value = pixel(glyph, x, y);
+        return value ? value : pixel(glyph, x - 1, y);
+    }
+    case GlyphTransform::Outline:
+        if (pixel(glyph, x, y))
+            return 0;
+        for (int dy = -1; dy <= 1; ++dy)
+            for (int dx = -1; dx <= 1; ++dx)
+                if (pixel(glyph, x + dx, y + dy))
+                    return maxValue;
+        return 0;
+    }
+    return -1;
+}
+
+void checkReference(GlyphTransform::Operation op, int (*pixel)(const uint8_t *, int, int),
+                    const uint8_t *original, const uint8_t *result, int maxValue)
+{
+    for (int y = 0; y < H; ++y)
+        for (int x = 0; x < UlfFont::GLYPH_W; ++x)
+            Q_ASSERT(pixel(result, x, y) == referencePixel(op, pixel, original, x, y, maxValue));
+}
+#endif
+
+} // namespace
+
+void GlyphTransform::transformBase(Operation op, uint8_t *glyph)
+{
+#ifndef QT_NO_DEBUG
+    uint8_t original[UlfFont::BASE_GLYPH_BYTES];
+    std::memcpy(original, glyph, sizeof(original));
+#endif
+    Plane p;
+    std::copy(glyph, glyph + H, p.begin());
+    switch (op) {
+    case Invert:
+        for (uint8_t &row : p)
+            row = uint8_t(~row);
+        break;
+    case Embolden:
+        for (uint8_t &row : p)
+            row |= row >> 1;
+        break;
+    case Outline: {
+        Plane ring = dilate(p);
+        for (int y = 0; y < H; ++y)
+            p[y] = ring[y] & ~p[y];
+        break;
+    }
+    default:
+        transformPlane(op, p);
+        break;
+    }
+    std::copy(p.begin(), p.end(), glyph);
+
+#ifndef QT_NO_DEBUG
+    // Debug builds cross-check the row kernels against the per-pixel reference
+    checkReference(op, &UlfFont::basePixel, original, glyph, 1);
+#endif
+}
+
+void GlyphTransform::transformOverlay(Operation op, uint8_t *glyph)
+{
+#ifndef QT_NO_DEBUG
+    uint8_t original[UlfFont::OVERLAY_GLYPH_BYTES];
+    std::memcpy(original, glyph, sizeof(original));
+#endif
+    Plane high, low;
+    splitOverlay(glyph, high, low);
+    switch (op) {
+    case Invert:
+        for (int y = 0; y < H; ++y) {
+            high[y] = uint8_t(~high[y]);
+            low[y] = uint8_t(~low[y]);
+        }
+        break;
+    case Embolden:
+        // Clear pixels take the color of the pixel on their left
+        for (int y = 0; y < H; ++y) {
+            uint8_t grown = uint8_t(((high[y] | low[y]) >> 1) & ~(high[y] | low[y]));
+            high[y] |= (high[y] >> 1) & grown;
+            low[y] |= (low[y] >> 1) & grown;
+        }
+        break;
+    case Outline: {
+        Plane mask;
+        for (int y = 0; y < H; ++y)
+            mask[y] = high[y] | low[y];
+        Plane ring = dilate(mask);
+        for (int y = 0; y < H; ++y)
+            high[y] = low[y] = ring[y] & ~mask[y];
+        break;
+    }
+    default:
+        transformPlane(op, high);
+        transformPlane(op, low);
+        break;
+    }
+    joinOverlay(high, low, glyph);
+
+#ifndef QT_NO_DEBUG
+    checkReference(op, &UlfFont::overlayPixel, original, glyph, 3);
+#endif
+}
+
+std::vector<GlyphEditCommand::GlyphDelta> GlyphTransform::run(const UlfFont *font, GlyphEditCommand::Layer layer,
+                                                              int first, int last, Operation op)
+{
+    std::vector<GlyphEditCommand::GlyphDelta> deltas;
+    deltas.reserve(last - first + 1);
+    for (int i = first; i <= last; ++i) {
+        GlyphEditCommand::GlyphDelta delta = GlyphEditCommand::capture(font, layer, i);
+        if (layer == GlyphEditCommand::Base)
+            transformBase(op, delta.after);
+        else
+            transformOverlay(op, delta.after);
+        if (!delta.isNoOp())
+            deltas.push_back(delta);
+    }
+    return deltas;
+}
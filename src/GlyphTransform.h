@@ -0,0 +1,35 @@
+#pragma once
+#include <vector>
+#include "UndoCommands.h"
+
+// Whole-glyph transforms that work on the packed rows directly. A base glyph
+// is one 1bpp plane of 16 row bytes; an overlay glyph is split into the high
+// and low bit planes of its 2bpp pixels, so every geometric transform is a
+// handful of byte operations per row (and table lookups for mirroring)
+// whatever the layer.
+class GlyphTransform {
+public:
+    enum Operation {
+        ShiftLeft,
+        ShiftRight,
+        ShiftUp,
+        ShiftDown,
+        MirrorHorizontal,
+        MirrorVertical,
+        // Quarter turns about the cell's center. Cells are 8x16, so only
+        // the middle 8x8 square stays inside; the rest is clipped.
+        RotateClockwise,
+        RotateCounterClockwise,
+        Invert,    // overlays: color n becomes 3 - n
+        Embolden,  // pixels also cover their right neighbour if it's clear
+        Outline,   // the glyph becomes the ring of pixels around it (overlays: color 3)
+    };
+
+    static void transformBase(Operation op, uint8_t *glyph);
+    static void transformOverlay(Operation op, uint8_t *glyph);
+
+    // Transformed images for glyphs first..last of one layer, leaving the
+    // font untouched; glyphs the transform doesn't change are left out
+    static std::vector<GlyphEditCommand::GlyphDelta> run(const UlfFont *font, GlyphEditCommand::Layer layer,
+                                                         int first, int last, Operation op);
+};
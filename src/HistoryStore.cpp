@@ -0,0 +1,198 @@
+#include "HistoryStore.h"
+#include <QDir>
+
+// The log is rewritten without released records once they take up more
+// than this and more than the live ones
+static constexpr qint64 COMPACT_THRESHOLD = 4 * 1024 * 1024;
+
+static std::unique_ptr<QTemporaryFile> openLog()
+{
+    auto log = std::make_unique<QTemporaryFile>(
+        QDir::tempPath() + QStringLiteral("/x16unifontedit-history-XXXXXX"));
+    if (!log->open())
+        return nullptr;
+    return log;
+}
+
+HistoryStore &HistoryStore::instance()
+{
+    static HistoryStore store;
+    return store;
+}
+
+HistoryStore::HistoryStore() = default;
+
+void HistoryStore::setMemoryBudget(qint64 bytes)
+{
+    m_budget = qMax<qint64>(0, bytes);
+    trim();
+}
+
+HistoryStore::RecordId HistoryStore::add(const QByteArray &data)
+{
+    RecordId id;
+    if (!m_freeIds.empty()) {
+        id = m_freeIds.back();
+        m_freeIds.pop_back();
+    } else {
+        id = (RecordId)m_records.size();
+        m_records.emplace_back();
+    }
+    m_records[id].size = data.size();
+    makeResident(id, data);
+    trim();
+    return id;
+}
+
+bool HistoryStore::get(RecordId id, QByteArray &data)
+{
+    Record &r = m_records[id];
+    if (r.resident) {
+        m_lru.erase({r.lastUse, id});
+        r.lastUse = ++m_useCounter;
+        m_lru.emplace(r.lastUse, id);
+        data = r.data;
+        return true;
+    }
+
+    data.clear();
+    QByteArray stored(r.storedSize, Qt::Uninitialized);
+    if (!m_log || !m_log->seek(r.offset) || m_log->read(stored.data(), r.storedSize) != r.storedSize) {
+        qWarning("HistoryStore: can't read record %u back from the history log", id);
+        return false;
+    }
+    QByteArray loaded = qUncompress(stored);
+    if (loaded.size() != r.size) {
+        qWarning("HistoryStore: record %u in the history log is corrupt", id);
+        return false;
+    }
+    data = loaded;
+    makeResident(id, std::move(loaded));
+    trim();
+    return true;
+}
+
+void HistoryStore::release(RecordId id)
+{
+    Record &r = m_records[id];
+    if (r.resident) {
+        m_lru.erase({r.lastUse, id});
+        m_resident -= r.size;
+    }
+    if (r.offset >= 0)
+        m_logLive -= r.storedSize;
+    r = Record();
+    m_freeIds.push_back(id);
+
+    qint64 dead = m_logEnd - m_logLive;
+    if (m_log && m_logLive == 0) {
+        m_log->resize(0);
+        m_logEnd = 0;
+    } else if (dead > COMPACT_THRESHOLD && dead > m_logLive) {
+        compactLog();
+    }
+}
+
+void HistoryStore::makeResident(RecordId id, QByteArray data)
+{
+    Record &r = m_records[id];
+    r.data = std::move(data);
+    r.resident = true;
+    r.lastUse = ++m_useCounter;
+    m_lru.emplace(r.lastUse, id);
+    m_resident += r.size;
+}
+
+void HistoryStore::trim()
+{
+    if (m_resident <= m_budget || m_logFailed)
+        return;
+
+    // Pick the least recently used records until we're within budget, and
+    // append the ones not in the log yet in one write
+    struct Placement {
+        RecordId id;
+        qint64 position;
+        int size;
+    };
+    std::vector<RecordId> victims;
+    std::vector<Placement> placements;
+    QByteArray batch;
+    qint64 freed = 0;
+    for (auto it = m_lru.begin(); it != m_lru.end() && m_resident - freed > m_budget; ++it) {
+        Record &r = m_records[it->second];
+        victims.push_back(it->second);
+        freed += r.size;
+        if (r.offset < 0) {
+            QByteArray stored = qCompress(r.data);
+            placements.push_back({it->second, batch.size(), (int)stored.size()});
+            batch += stored;
+        }
+    }
+
+    if (!batch.isEmpty()) {
+        qint64 offset;
+        if (!writeLog(batch, offset)) {
+            // Keep the history in memory rather than lose any of it
+            m_logFailed = true;
+            return;
+        }
+        for (const Placement &p : placements) {
+            m_records[p.id].offset = offset + p.position;
+            m_records[p.id].storedSize = p.size;
+            m_logLive += p.size;
+        }
+    }
+
+    for (RecordId id : victims) {
+        Record &r = m_records[id];
+        m_lru.erase({r.lastUse, id});
+        r.data = QByteArray();
+        r.resident = false;
+        m_resident -= r.size;
+    }
+}
+
+bool HistoryStore::writeLog(const QByteArray &bytes, qint64 &offset)
+{
+    if (!m_log) {
+        m_log = openLog();
+        m_logEnd = 0;
+        if (!m_log)
+            return false;
+    }
+    if (!m_log->seek(m_logEnd) || m_log->write(bytes) != bytes.size())
+        return false;
+    offset = m_logEnd;
+    m_logEnd += bytes.size();
+    return true;
+}
+
+void HistoryStore::compactLog()
+{
+    std::unique_ptr<QTemporaryFile> log = openLog();
+    if (!log)
+        return;
+
+    // Copy live records over, committing the new offsets only once the
+    // whole copy has succeeded
+    std::vector<std::pair<RecordId, qint64>> moved;
+    qint64 end = 0;
+    QByteArray stored;
+    for (RecordId id = 0; id < (RecordId)m_records.size(); ++id) {
+        const Record &r = m_records[id];
+        if (r.offset < 0)
+            continue;
+        stored.resize(r.storedSize);
+        if (!m_log->seek(r.offset) || m_log->read(stored.data(), r.storedSize) != r.storedSize
+            || log->write(stored) != stored.size())
+            return;
+        moved.emplace_back(id, end);
+        end += r.storedSize;
+    }
+
+    for (const auto &[id, offset] : moved)
+        m_records[id].offset = offset;
+    m_log = std::move(log);
+    m_logEnd = end;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <QByteArray>
+#include <QTemporaryFile>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <vector>
+
+// Keeps the bulky part of undo commands (glyph images, removed blocks) within
+// a memory budget. The least recently used records past the budget are
+// compressed and appended to a log file in the temp directory, and read back
+// when a command is undone or redone that far. Commands themselves only keep
+// a record id, so the undo stack can grow without limit.
+class HistoryStore {
+public:
+    using RecordId = uint32_t;
+    static constexpr qint64 DEFAULT_MEMORY_BUDGET = 16 * 1024 * 1024;
+
+    static HistoryStore &instance();
+
+    HistoryStore();
+    HistoryStore(const HistoryStore &) = delete;
+    HistoryStore &operator=(const HistoryStore &) = delete;
+
+    void setMemoryBudget(qint64 bytes);
+    qint64 memoryBudget() const { return m_budget; }
+    qint64 residentBytes() const { return m_resident; }
+    // Bytes in the log that still belong to live records
+    qint64 spilledBytes() const { return m_logLive; }
+
+    RecordId add(const QByteArray &data);
+    // Pages the record back in if it was spilled. False if it couldn't be
+    // read back from the log, in which case data is left empty.
+    bool get(RecordId id, QByteArray &data);
+    void release(RecordId id);
+
+private:
+    struct Record {
+        QByteArray data;     // dropped while only in the log
+        int size = 0;
+        qint64 offset = -1;  // position in the log, or -1 if never spilled
+        int storedSize = 0;  // compressed size in the log
+        uint64_t lastUse = 0;
+        bool resident = false;
+    };
+
+    void makeResident(RecordId id, QByteArray data);
+    void trim();
+    bool writeLog(const QByteArray &bytes, qint64 &offset);
+    void compactLog();
+
+    qint64 m_budget = DEFAULT_MEMORY_BUDGET;
+    qint64 m_resident = 0;
+    uint64_t m_useCounter = 0;
+
+    std::vector<Record> m_records;  // by id
+    std::vector<RecordId> m_freeIds;
+    std::set<std::pair<uint64_t, RecordId>> m_lru;  // resident records by last use
+
+    std::unique_ptr<QTemporaryFile> m_log;
+    qint64 m_logEnd = 0;
+    qint64 m_logLive = 0;
+    bool m_logFailed = false;  // stop trying to spill after a write error
+};
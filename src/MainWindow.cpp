@@ -2,9 +2,19 @@
 #include "GlyphEditor.h"
 #include "GlyphGrid.h"
 #include "CompositePreview.h"
+#include "TextPreview.h"
+#include "ScreenSimulator.h"
 #include "UnicodeMapEditor.h"
 #include "ColorSettings.h"
+#include "FontNotifier.h"
+#include "ReferenceResolver.h"
+#include "FontLoader.h"
+#include "FontSaver.h"
+#include "UlfFontSnapshot.h"
+#include "EditJournal.h"
 #include "UndoCommands.h"
+#include "GlyphDedup.h"
+#include "HistoryStore.h"
 #include "UnicodeInfo.h"
 #include <QSplitter>
 #include <QScrollArea>
@@ -12,43 +22,76 @@
 #include <QHBoxLayout>
 #include <QGridLayout>
 #include <QLabel>
-#include <QLineEdit>
+#include <QPlainTextEdit>
+#include <QTextDocument>
+#include <QTimer>
 #include <QCheckBox>
 #include <QGroupBox>
 #include <QMenuBar>
 #include <QMenu>
 #include <QAction>
 #include <QFileDialog>
+#include <QInputDialog>
 #include <QMessageBox>
 #include <QCloseEvent>
 #include <QUndoStack>
 #include <QStatusBar>
+#include <QProgressBar>
+#include <QToolButton>
 #include <QKeySequence>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
 {
+    m_fontNotifier = new FontNotifier(this);
     m_colorSettings = new ColorSettings(this);
     m_undoStack = new QUndoStack(this);
+    m_refResolver = new ReferenceResolver(this);
+    m_loader = new FontLoader(this);
+    m_saver = new FontSaver(this);
     m_font.clear();
+    m_font.setNotifier(m_fontNotifier);
+    m_journal = new EditJournal(&m_font, this);
 
     buildUI();
     setupMenus();
     statusBar()->showMessage(tr("Ready"));
 
+    m_loadProgress = new QProgressBar;
+    m_loadProgress->setRange(0, 100);
+    m_loadProgress->setMaximumWidth(200);
+    m_loadCancel = new QToolButton;
+    m_loadCancel->setText(tr("Cancel"));
+    statusBar()->addPermanentWidget(m_loadProgress);
+    statusBar()->addPermanentWidget(m_loadCancel);
+    m_loadProgress->hide();
+    m_loadCancel->hide();
+
     connect(m_undoStack, &QUndoStack::cleanChanged, this, &MainWindow::onCleanChanged);
-    connect(m_colorSettings, &ColorSettings::colorsChanged, this, [this]() {
-        m_baseGrid->refreshAll();
-        m_overlayGrid->refreshAll();
-        m_baseEditor->update();
-        m_overlayEditor->update();
-        m_compositePreview->update();
-        m_textPreview->update();
+    connect(m_loader, &FontLoader::progress, this, [this](qint64 bytesRead, qint64 bytesTotal) {
+        m_loadProgress->setValue(bytesTotal > 0 ? (int)(bytesRead * 100 / bytesTotal) : 0);
+    });
+    connect(m_loader, &FontLoader::finished, this, &MainWindow::onFontLoaded);
+    connect(m_loadCancel, &QToolButton::clicked, this, &MainWindow::cancelLoad);
+    connect(m_saver, &FontSaver::finished, this, &MainWindow::onFontSaved);
+    // Queued: the stack can't be cleared from inside the undo() that failed
+    connect(m_fontNotifier, &FontNotifier::historyLost, this, &MainWindow::onHistoryLost,
+            Qt::QueuedConnection);
+    connect(m_journal, &EditJournal::failed, this, [this](const QString &path) {
+        statusBar()->showMessage(tr("Can't write %1: changes from now on won't be recovered after a crash")
+                                     .arg(path));
     });
 
     updateTitle();
 }
 
+MainWindow::~MainWindow()
+{
+    // m_font is destroyed before the journal, which is a child; edits not
+    // yet committed are written while the font is still there
+    m_journal->commit();
+}
+
 void MainWindow::buildUI()
 {
     // ===== Create all widgets =====
@@ -228,44 +271,67 @@ void MainWindow::buildUI()
     auto *mainSplit = new QSplitter(Qt::Vertical);
     mainSplit->addWidget(topSplit);
     mainSplit->addWidget(gridScroll);
-    mainSplit->setStretchFactor(0, 0);
-    mainSplit->setStretchFactor(1, 1);
 
-    // -- Bottom bar: text preview --
+    // -- Bottom: text preview, sized through the splitter --
     auto *textBar = new QWidget;
     auto *textBarLayout = new QHBoxLayout(textBar);
     textBarLayout->setContentsMargins(4, 2, 4, 2);
-    m_textInput = new QLineEdit;
-    m_textInput->setPlaceholderText(tr("Type text to preview..."));
+    m_textInput = new QPlainTextEdit;
+    m_textInput->setPlaceholderText(tr("Type or paste text to preview..."));
     m_textInput->setMaximumWidth(300);
     textBarLayout->addWidget(m_textInput);
     textBarLayout->addWidget(m_textPreview, 1);
+    mainSplit->addWidget(textBar);
+    mainSplit->setStretchFactor(0, 0);
+    mainSplit->setStretchFactor(1, 1);
+    mainSplit->setStretchFactor(2, 0);
 
     auto *centralWidget = new QWidget;
     auto *centralLayout = new QVBoxLayout(centralWidget);
     centralLayout->setContentsMargins(2, 2, 2, 2);
     centralLayout->setSpacing(2);
     centralLayout->addWidget(mainSplit, 1);
-    centralLayout->addWidget(textBar);
     setCentralWidget(centralWidget);
 
     // ===== Connections =====
 
     connect(m_mapEditor, &UnicodeMapEditor::entrySelected, this, &MainWindow::onMapEntrySelected);
-    connect(m_mapEditor, &UnicodeMapEditor::mapModified, this, &MainWindow::onMapModified);
+    connect(m_mapEditor, &UnicodeMapEditor::blockExpanded, this, [this](int blockIndex) {
+        const auto &block = m_font.unicodeMap[blockIndex];
+        m_refResolver->prefetch(block.startCodepoint, (uint32_t)block.entries.size());
+    });
+    connect(m_refResolver, &ReferenceResolver::resolved, this, &MainWindow::onReferenceResolved);
+
+    // Views subscribe to the font notifier themselves; only the selected
+    // entry's controls are kept in step here. The map editor is connected
+    // first, so its rows are current by the time these run.
+    connect(m_fontNotifier, &FontNotifier::entryChanged, this, &MainWindow::onMapEntryChanged);
+    connect(m_fontNotifier, &FontNotifier::blockInserted, this, &MainWindow::onMapStructureChanged);
+    connect(m_fontNotifier, &FontNotifier::blockRemoved, this, &MainWindow::onMapStructureChanged);
+    connect(m_fontNotifier, &FontNotifier::entryInserted, this, &MainWindow::onMapStructureChanged);
+    connect(m_fontNotifier, &FontNotifier::entryRemoved, this, &MainWindow::onMapStructureChanged);
+    connect(m_fontNotifier, &FontNotifier::fontReset, this, &MainWindow::onMapStructureChanged);
 
     connect(m_baseGrid, &GlyphGrid::glyphSelected, this, &MainWindow::onBaseGlyphSelected);
     connect(m_overlayGrid, &GlyphGrid::glyphSelected, this, &MainWindow::onOverlayGlyphSelected);
 
-    connect(m_baseEditor, &GlyphEditor::glyphModified, this, &MainWindow::onGlyphModified);
-    connect(m_overlayEditor, &GlyphEditor::glyphModified, this, &MainWindow::onGlyphModified);
-
     connect(m_reverseCheck, &QCheckBox::toggled, this, &MainWindow::onFlagToggled);
     connect(m_hflipCheck, &QCheckBox::toggled, this, &MainWindow::onFlagToggled);
     connect(m_vflipCheck, &QCheckBox::toggled, this, &MainWindow::onFlagToggled);
     connect(m_noGlyphCheck, &QCheckBox::toggled, this, &MainWindow::onFlagToggled);
 
-    connect(m_textInput, &QLineEdit::textChanged, m_textPreview, &TextPreview::setText);
+    // Typing into a large document would re-read all of it per keystroke;
+    // coalesce bursts of edits into one update
+    m_textTimer = new QTimer(this);
+    m_textTimer->setSingleShot(true);
+    connect(m_textTimer, &QTimer::timeout, this, [this]() {
+        m_textPreview->setText(m_textInput->toPlainText());
+        if (m_simulator)
+            m_simulator->setText(m_textInput->toPlainText());
+    });
+    connect(m_textInput, &QPlainTextEdit::textChanged, this, [this]() {
+        m_textTimer->start(m_textInput->document()->characterCount() > 100000 ? 150 : 0);
+    });
 }
 
 void MainWindow::setupMenus()
@@ -273,26 +339,107 @@ void MainWindow::setupMenus()
     auto *fileMenu = menuBar()->addMenu(tr("&File"));
     fileMenu->addAction(tr("&New"), QKeySequence::New, this, &MainWindow::newFile);
     fileMenu->addAction(tr("&Open..."), QKeySequence::Open, this, &MainWindow::open);
-    fileMenu->addAction(tr("&Save"), QKeySequence::Save, this, &MainWindow::save);
-    fileMenu->addAction(tr("Save &As..."), QKeySequence::SaveAs, this, &MainWindow::saveAs);
+    m_fontActions << fileMenu->addAction(tr("&Save"), QKeySequence::Save, this, &MainWindow::save);
+    m_fontActions << fileMenu->addAction(tr("Save &As..."), QKeySequence::SaveAs, this, &MainWindow::saveAs);
     fileMenu->addSeparator();
     fileMenu->addAction(tr("&Quit"), QKeySequence::Quit, this, &QWidget::close);
 
     auto *editMenu = menuBar()->addMenu(tr("&Edit"));
-    QAction *undoAction = m_undoStack->createUndoAction(this, tr("&Undo"));
-    undoAction->setShortcut(QKeySequence::Undo);
-    editMenu->addAction(undoAction);
-    QAction *redoAction = m_undoStack->createRedoAction(this, tr("&Redo"));
-    redoAction->setShortcut(QKeySequence::Redo);
-    editMenu->addAction(redoAction);
+    m_undoAction = m_undoStack->createUndoAction(this, tr("&Undo"));
+    m_undoAction->setShortcut(QKeySequence::Undo);
+    editMenu->addAction(m_undoAction);
+    m_redoAction = m_undoStack->createRedoAction(this, tr("&Redo"));
+    m_redoAction->setShortcut(QKeySequence::Redo);
+    editMenu->addAction(m_redoAction);
+    editMenu->addSeparator();
+
+    // Shift-click in a glyph grid selects a range to transform
+    struct Transform {
+        GlyphTransform::Operation op;
+        QString name;
+        bool separatorBefore;
+    };
+    const Transform transforms[] = {
+        {GlyphTransform::ShiftLeft, tr("Shift &Left"), false},
+        {GlyphTransform::ShiftRight, tr("Shift &Right"), false},
+        {GlyphTransform::ShiftUp, tr("Shift &Up"), false},
+        {GlyphTransform::ShiftDown, tr("Shift &Down"), false},
+        {GlyphTransform::MirrorHorizontal, tr("Mirror &Horizontally"), true},
+        {GlyphTransform::MirrorVertical, tr("Mirror &Vertically"), false},
+        {GlyphTransform::RotateClockwise, tr("Rotate &Clockwise"), false},
+        {GlyphTransform::RotateCounterClockwise, tr("Rotate Counterclock&wise"), false},
+        {GlyphTransform::Invert, tr("&Invert"), true},
+        {GlyphTransform::Embolden, tr("&Embolden"), false},
+        {GlyphTransform::Outline, tr("&Outline"), false},
+    };
+    QMenu *baseTransformMenu = editMenu->addMenu(tr("Transform &Base Glyphs"));
+    QMenu *overlayTransformMenu = editMenu->addMenu(tr("Transform &Overlay Glyphs"));
+    for (const Transform &t : transforms) {
+        if (t.separatorBefore) {
+            baseTransformMenu->addSeparator();
+            overlayTransformMenu->addSeparator();
+        }
+        QString name = QString(t.name).remove(QLatin1Char('&'));
+        GlyphTransform::Operation op = t.op;
+        m_fontActions << baseTransformMenu->addAction(t.name, this, [this, op, name]() {
+            transformGlyphs(GlyphEditCommand::Base, op, name);
+        });
+        m_fontActions << overlayTransformMenu->addAction(t.name, this, [this, op, name]() {
+            transformGlyphs(GlyphEditCommand::Overlay, op, name);
+        });
+    }
 
     auto *viewMenu = menuBar()->addMenu(tr("&View"));
     viewMenu->addAction(tr("Zoom &In"), QKeySequence::ZoomIn, this, &MainWindow::zoomIn);
     viewMenu->addAction(tr("Zoom &Out"), QKeySequence::ZoomOut, this, &MainWindow::zoomOut);
     viewMenu->addAction(tr("Zoom &Reset"), QKeySequence(Qt::CTRL | Qt::Key_0), this, &MainWindow::zoomReset);
+    viewMenu->addSeparator();
+    QAction *usageAction = viewMenu->addAction(tr("Show Glyph &Usage"));
+    usageAction->setCheckable(true);
+    connect(usageAction, &QAction::toggled, this, [this](bool on) {
+        m_baseGrid->setShowUsage(on);
+        m_overlayGrid->setShowUsage(on);
+    });
+    viewMenu->addSeparator();
+    viewMenu->addAction(tr("X16 &Screen Simulator..."), this, &MainWindow::showScreenSimulator);
 
     auto *toolsMenu = menuBar()->addMenu(tr("&Tools"));
     toolsMenu->addAction(tr("&Color Settings..."), this, &MainWindow::showColorSettings);
+    toolsMenu->addAction(tr("Undo &History Memory..."), this, &MainWindow::setHistoryBudget);
+    toolsMenu->addSeparator();
+    m_fontActions << toolsMenu->addAction(tr("&Merge Duplicate Glyphs"), this, &MainWindow::mergeDuplicateGlyphs);
+}
+
+void MainWindow::transformGlyphs(GlyphEditCommand::Layer layer, GlyphTransform::Operation op,
+                                 const QString &name)
+{
+    GlyphGrid *grid = layer == GlyphEditCommand::Base ? m_baseGrid : m_overlayGrid;
+    auto deltas = GlyphTransform::run(&m_font, layer, grid->rangeFirst(), grid->rangeLast(), op);
+    if (deltas.empty())
+        return;
+    m_undoStack->push(new GlyphEditCommand(&m_font,
+        tr("%1 (%n glyph(s))", nullptr, (int)deltas.size()).arg(name), deltas));
+}
+
+void MainWindow::mergeDuplicateGlyphs()
+{
+    GlyphDedup::Plan plan = GlyphDedup::plan(&m_font);
+    if (plan.isEmpty()) {
+        statusBar()->showMessage(tr("No duplicate glyphs found"), 3000);
+        return;
+    }
+
+    // Entries are repointed before the merged slots are cleared, so every
+    // step of redo (and undo) shows the same text
+    auto *command = new QUndoCommand(tr("Merge duplicate glyphs"));
+    for (const GlyphDedup::EntryEdit &edit : plan.entries)
+        new EditMapEntryCommand(&m_font, edit.blockIndex, edit.entryIndex, edit.entry, command);
+    if (!plan.clearedGlyphs.empty())
+        new GlyphEditCommand(&m_font, QString(), plan.clearedGlyphs, command);
+    m_undoStack->push(command);
+
+    statusBar()->showMessage(tr("Merged %1 base and %2 overlay glyphs")
+        .arg(plan.baseMerged).arg(plan.overlayMerged), 3000);
 }
 
 void MainWindow::onMapEntrySelected(int blockIndex, int entryIndex)
@@ -319,51 +466,70 @@ void MainWindow::onMapEntrySelected(int blockIndex, int entryIndex)
             syncFlagControls(entry);
             updateComposite();
 
-            // Update Unicode character reference
+            // The reference pane fills in once the resolver has the
+            // codepoint; everything above is already up to date
             uint32_t cp = block.startCodepoint + entryIndex;
-            QString ch = unicodeCharStr(cp);
-            m_unicodeCharLabel->setText(ch);
-
-            // Try font fallback if system font doesn't have the glyph
-            int charPtSize = m_unicodeCharLabel->width() * 2 / 3;
-            QString fallbackFamily = fontForCodepoint(cp);
-            if (!fallbackFamily.isEmpty()) {
-                QFont f(fallbackFamily, charPtSize);
-                m_unicodeCharLabel->setFont(f);
+            m_refCodepoint = cp;
+            if (const CodepointReference *ref = m_refResolver->find(cp)) {
+                showReference(cp, *ref);
             } else {
-                QFont f = font();
-                f.setPointSize(charPtSize);
-                m_unicodeCharLabel->setFont(f);
+                m_refLabel->setText(unicodeCodepointStr(cp));
+                m_unicodeCharLabel->clear();
+                m_unicodeInfoLabel->clear();
+                m_refResolver->request(cp);
             }
 
-            // Header label: codepoint + block name
-            QString header = unicodeCodepointStr(cp);
-            QString blockName = unicodeBlockName(cp);
-            if (!blockName.isEmpty())
-                header += "  " + blockName;
-            m_refLabel->setText(header);
-
-            // Info label: just the character name (+ fallback font if used)
-            QString charName = unicodeCharName(cp);
-            if (!fallbackFamily.isEmpty() && !charName.isEmpty())
-                charName += "\n(" + fallbackFamily + ")";
-            else if (!fallbackFamily.isEmpty())
-                charName = "(" + fallbackFamily + ")";
-            m_unicodeInfoLabel->setText(charName);
-
-            statusBar()->showMessage(QStringLiteral("U+%1 — Base: %2, Overlay: %3")
+            UnicodeCategory category = unicodeCategory(cp);
+            statusBar()->showMessage(QStringLiteral("U+%1 %2 (%3) — Base: %4, Overlay: %5")
                 .arg(cp, 4, 16, QChar('0')).toUpper()
+                .arg(QLatin1String(unicodeCategoryCode(category)))
+                .arg(QLatin1String(unicodeCategoryName(category)))
                 .arg(entry.baseIndex)
                 .arg(entry.overlayIndex));
             return;
         }
     }
     m_compositePreview->clearEntry();
+    m_refCodepoint = -1;
     m_refLabel->setText(tr("Reference"));
     m_unicodeCharLabel->clear();
     m_unicodeInfoLabel->clear();
 }
 
+void MainWindow::onReferenceResolved(uint32_t cp)
+{
+    if (cp != m_refCodepoint)
+        return;
+    if (const CodepointReference *ref = m_refResolver->find(cp))
+        showReference(cp, *ref);
+}
+
+void MainWindow::showReference(uint32_t cp, const CodepointReference &ref)
+{
+    m_unicodeCharLabel->setText(ref.character);
+
+    // Use the fallback font if the system font doesn't have the glyph; only
+    // touch the label's font when it actually changes
+    QFont f = ref.fallbackFamily.isEmpty() ? font() : QFont(ref.fallbackFamily);
+    f.setPointSize(m_unicodeCharLabel->width() * 2 / 3);
+    if (f != m_unicodeCharLabel->font())
+        m_unicodeCharLabel->setFont(f);
+
+    // Header label: codepoint + block name
+    QString header = unicodeCodepointStr(cp);
+    if (!ref.blockName.isEmpty())
+        header += "  " + ref.blockName;
+    m_refLabel->setText(header);
+
+    // Info label: just the character name (+ fallback font if used)
+    QString charName = ref.name;
+    if (!ref.fallbackFamily.isEmpty() && !charName.isEmpty())
+        charName += "\n(" + ref.fallbackFamily + ")";
+    else if (!ref.fallbackFamily.isEmpty())
+        charName = "(" + ref.fallbackFamily + ")";
+    m_unicodeInfoLabel->setText(charName);
+}
+
 void MainWindow::onBaseGlyphSelected(int index)
 {
     m_baseEditor->setGlyphIndex(index);
@@ -378,9 +544,7 @@ void MainWindow::onBaseGlyphSelected(int index)
             block.entries[m_selEntry].baseIndex != (uint8_t)index) {
             UnicodeMapEntry newEntry = block.entries[m_selEntry];
             newEntry.baseIndex = index;
-            m_undoStack->push(new EditMapEntryCommand(&m_font, m_selBlock, m_selEntry, newEntry));
-            m_mapEditor->rebuild();
-            updateComposite();
+            m_mapEditor->setEntry(m_selBlock, m_selEntry, newEntry);
         }
     }
 }
@@ -399,25 +563,26 @@ void MainWindow::onOverlayGlyphSelected(int index)
             block.entries[m_selEntry].overlayIndex != (uint16_t)index) {
             UnicodeMapEntry newEntry = block.entries[m_selEntry];
             newEntry.overlayIndex = index;
-            m_undoStack->push(new EditMapEntryCommand(&m_font, m_selBlock, m_selEntry, newEntry));
-            m_mapEditor->rebuild();
-            updateComposite();
+            m_mapEditor->setEntry(m_selBlock, m_selEntry, newEntry);
         }
     }
 }
 
-void MainWindow::onGlyphModified()
+void MainWindow::onMapEntryChanged(int blockIndex, int entryIndex)
 {
-    m_baseGrid->refreshAll();
-    m_overlayGrid->refreshAll();
+    if (blockIndex != m_selBlock || entryIndex != m_selEntry)
+        return;
+    syncFlagControls(m_font.unicodeMap[blockIndex].entries[entryIndex]);
     updateComposite();
-    m_textPreview->update();
 }
 
-void MainWindow::onMapModified()
+void MainWindow::onMapStructureChanged()
 {
+    // Rows may have shifted under the selection
+    auto [bi, ei] = m_mapEditor->currentBlockEntry();
+    m_selBlock = bi;
+    m_selEntry = ei;
     updateComposite();
-    m_textPreview->update();
 }
 
 void MainWindow::onFlagToggled()
@@ -437,9 +602,7 @@ void MainWindow::onFlagToggled()
     newEntry.vflip = m_vflipCheck->isChecked();
     newEntry.noGlyph = m_noGlyphCheck->isChecked();
 
-    m_undoStack->push(new EditMapEntryCommand(&m_font, m_selBlock, m_selEntry, newEntry));
-    m_mapEditor->rebuild();
-    updateComposite();
+    m_mapEditor->setEntry(m_selBlock, m_selEntry, newEntry);
 }
 
 void MainWindow::syncFlagControls(const UnicodeMapEntry &entry)
@@ -469,6 +632,9 @@ void MainWindow::newFile()
 {
     if (!maybeSave())
         return;
+    if (m_loader->isLoading())
+        cancelLoad();
+    m_journal->discard();
     m_font.clear();
     m_filePath.clear();
     m_undoStack->clear();
@@ -478,10 +644,9 @@ void MainWindow::newFile()
     m_baseEditor->setGlyphIndex(0);
     m_overlayGrid->setSelectedIndex(0);
     m_overlayEditor->setGlyphIndex(0);
-    m_mapEditor->rebuild();
-    m_compositePreview->clearEntry();
-    m_baseGrid->refreshAll();
-    m_overlayGrid->refreshAll();
+    // The map editor restores its selection when the font is reset
+    auto [bi, ei] = m_mapEditor->currentBlockEntry();
+    onMapEntrySelected(bi, ei);
     updateTitle();
 }
 
@@ -500,27 +665,90 @@ void MainWindow::open()
 
 void MainWindow::openFile(const QString &path)
 {
-    if (!m_font.loadFromFile(path)) {
+    // Reading and parsing happen on the loader's thread, so the window keeps
+    // painting; editing waits until the new font has been swapped in
+    m_loader->load(path);
+    m_loadProgress->setValue(0);
+    m_loadProgress->show();
+    m_loadCancel->show();
+    // Edits to the old font would be dropped when the new one is adopted
+    centralWidget()->setEnabled(false);
+    for (QAction *action : m_fontActions)
+        action->setEnabled(false);
+    m_undoAction->setEnabled(false);
+    m_redoAction->setEnabled(false);
+    statusBar()->showMessage(tr("Loading %1...").arg(path));
+}
+
+void MainWindow::onFontLoaded(const QString &path, std::shared_ptr<UlfFont> font)
+{
+    endLoad();
+    if (!font) {
+        statusBar()->clearMessage();
         QMessageBox::critical(this, tr("Error"),
             tr("Failed to load font file:\n%1").arg(path));
         return;
     }
 
+    // The old font's journal goes only now that it's being replaced, and
+    // before the check so reopening the same file doesn't offer this
+    // session's own (declined) changes for recovery
+    m_journal->discard();
+
+    // A journal left behind by a session that didn't close cleanly
+    EditJournal::Recovery recovery = EditJournal::check(path, *font);
+    bool recover = recovery.records > 0
+        && QMessageBox::question(this, tr("Recover Changes"),
+               tr("%1 has unsaved changes from a session that didn't close cleanly.\n"
+                  "Do you want to recover them?").arg(QFileInfo(path).fileName()))
+           == QMessageBox::Yes;
+    qint64 replayed = recover ? EditJournal::replay(recovery, *font) : 0;
+
+    m_font.adopt(*font);
     m_filePath = path;
     m_undoStack->clear();
     m_undoStack->setClean();
+    if (recover)
+        m_undoStack->resetClean();
+    m_journal->start(path, replayed);
     m_selBlock = -1;
     m_selEntry = -1;
     m_baseGrid->setSelectedIndex(0);
     m_baseEditor->setGlyphIndex(0);
     m_overlayGrid->setSelectedIndex(0);
     m_overlayEditor->setGlyphIndex(0);
-    m_mapEditor->rebuild();
-    m_compositePreview->clearEntry();
-    m_baseGrid->refreshAll();
-    m_overlayGrid->refreshAll();
+    // The map editor restores its selection when the font is reset
+    auto [bi, ei] = m_mapEditor->currentBlockEntry();
+    onMapEntrySelected(bi, ei);
+    if (bi >= 0) {
+        const auto &block = m_font.unicodeMap[bi];
+        m_refResolver->prefetch(block.startCodepoint, (uint32_t)block.entries.size());
+    }
     updateTitle();
-    statusBar()->showMessage(tr("Loaded %1").arg(path), 3000);
+    statusBar()->showMessage(recover ? tr("Recovered unsaved changes to %1").arg(path)
+                                     : tr("Loaded %1").arg(path), 3000);
+    if (recover && replayed < recovery.validBytes)
+        QMessageBox::warning(this, tr("Recover Changes"),
+            tr("Some of the recovered changes to %1 didn't match the font and were dropped, "
+               "along with everything after them.").arg(QFileInfo(path).fileName()));
+}
+
+void MainWindow::cancelLoad()
+{
+    m_loader->cancel();
+    endLoad();
+    statusBar()->showMessage(tr("Loading cancelled"), 3000);
+}
+
+void MainWindow::endLoad()
+{
+    m_loadProgress->hide();
+    m_loadCancel->hide();
+    centralWidget()->setEnabled(true);
+    for (QAction *action : m_fontActions)
+        action->setEnabled(true);
+    m_undoAction->setEnabled(m_undoStack->canUndo());
+    m_redoAction->setEnabled(m_undoStack->canRedo());
 }
 
 void MainWindow::save()
@@ -529,15 +757,56 @@ void MainWindow::save()
         saveAs();
         return;
     }
+    saveTo(m_filePath);
+}
 
-    if (!m_font.saveToFile(m_filePath)) {
+void MainWindow::saveTo(const QString &path)
+{
+    // One save at a time, so each result settles the journal and the clean
+    // state it started with; this only waits if Save is hit in quick succession
+    m_saver->waitForFinished();
+    m_journal->beginSave();
+    m_saver->save(path, m_font.snapshot());
+    statusBar()->showMessage(tr("Saving %1...").arg(path));
+}
+
+void MainWindow::onFontSaved(const QString &path, uint64_t version, uint64_t hash, bool ok)
+{
+    if (!ok) {
+        m_journal->abortSave();
+        statusBar()->clearMessage();
         QMessageBox::critical(this, tr("Error"),
-            tr("Failed to save font file:\n%1").arg(m_filePath));
+            tr("Failed to save font file:\n%1").arg(path));
         return;
     }
 
-    m_undoStack->setClean();
-    statusBar()->showMessage(tr("Saved %1").arg(m_filePath), 3000);
+    // A Save As target becomes the font's file only once it's written
+    if (path != m_filePath) {
+        m_filePath = path;
+        updateTitle();
+    }
+    m_journal->endSave(path, hash);
+    // Only the state that was snapshotted is on disk. If editing went on
+    // meanwhile, no index on the stack is known to match the file any more.
+    if (m_font.version() == version)
+        m_undoStack->setClean();
+    else
+        m_undoStack->resetClean();
+    statusBar()->showMessage(tr("Saved %1").arg(path), 3000);
+}
+
+void MainWindow::onHistoryLost(const QString &commandText)
+{
+    // The commands of one macro each report the same loss
+    if (m_undoStack->count() == 0)
+        return;
+    m_undoStack->clear();
+    // Whatever the font holds now, it isn't known to match the file
+    m_undoStack->resetClean();
+    QMessageBox::warning(this, tr("Undo History Lost"),
+        tr("The saved state of \"%1\" couldn't be read back from the undo history file, "
+           "so the font was left as it was.\n\n"
+           "The undo history no longer matches the font and has been cleared.").arg(commandText));
 }
 
 void MainWindow::saveAs()
@@ -547,9 +816,7 @@ void MainWindow::saveAs()
     if (path.isEmpty())
         return;
 
-    m_filePath = path;
-    save();
-    updateTitle();
+    saveTo(path);
 }
 
 void MainWindow::onCleanChanged(bool clean)
@@ -570,6 +837,8 @@ void MainWindow::updateTitle()
 
 bool MainWindow::maybeSave()
 {
+    // A save still being written may be what makes the font clean
+    m_saver->waitForFinished();
     if (m_undoStack->isClean())
         return true;
 
@@ -579,6 +848,7 @@ bool MainWindow::maybeSave()
 
     if (ret == QMessageBox::Save) {
         save();
+        m_saver->waitForFinished();
         return m_undoStack->isClean();
     }
     return ret == QMessageBox::Discard;
@@ -586,9 +856,10 @@ bool MainWindow::maybeSave()
 
 void MainWindow::closeEvent(QCloseEvent *event)
 {
-    if (maybeSave())
+    if (maybeSave()) {
+        m_journal->discard();
         event->accept();
-    else
+    } else
         event->ignore();
 }
 
@@ -615,3 +886,28 @@ void MainWindow::showColorSettings()
     ColorSettingsDialog dlg(m_colorSettings, this);
     dlg.exec();
 }
+
+void MainWindow::setHistoryBudget()
+{
+    HistoryStore &store = HistoryStore::instance();
+    constexpr qint64 MiB = 1024 * 1024;
+    bool ok = false;
+    int budget = QInputDialog::getInt(this, tr("Undo History Memory"),
+        tr("Memory for undo history, in MiB. Older steps are kept on disk.\n"
+           "In memory: %1 KiB, on disk: %2 KiB")
+            .arg(store.residentBytes() / 1024).arg(store.spilledBytes() / 1024),
+        (int)(store.memoryBudget() / MiB), 1, 4096, 1, &ok);
+    if (ok)
+        store.setMemoryBudget(budget * MiB);
+}
+
+void MainWindow::showScreenSimulator()
+{
+    if (!m_simulator) {
+        m_simulator = new ScreenSimulatorWindow(&m_font, m_colorSettings, this);
+        m_simulator->setText(m_textInput->toPlainText());
+    }
+    m_simulator->show();
+    m_simulator->raise();
+    m_simulator->activateWindow();
+}
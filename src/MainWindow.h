@@ -1,22 +1,36 @@
 #pragma once
 #include <QMainWindow>
+#include <memory>
 #include "UlfFont.h"
+#include "GlyphTransform.h"
 
 class GlyphEditor;
 class GlyphGrid;
 class CompositePreview;
 class TextPreview;
+class ScreenSimulatorWindow;
 class UnicodeMapEditor;
 class ColorSettings;
+class FontNotifier;
+class ReferenceResolver;
+class FontLoader;
+class FontSaver;
+class EditJournal;
+struct CodepointReference;
 class QUndoStack;
-class QLineEdit;
+class QPlainTextEdit;
+class QTimer;
 class QLabel;
+class QProgressBar;
+class QToolButton;
 class QCheckBox;
+class QAction;
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
 public:
     explicit MainWindow(QWidget *parent = nullptr);
+    ~MainWindow() override;
 
     void openFile(const QString &path);
 
@@ -29,15 +43,23 @@ private slots:
     void save();
     void saveAs();
     void onCleanChanged(bool clean);
+    void onFontLoaded(const QString &path, std::shared_ptr<UlfFont> font);
+    void onFontSaved(const QString &path, uint64_t version, uint64_t hash, bool ok);
+    void onHistoryLost(const QString &commandText);
+    void cancelLoad();
     void onBaseGlyphSelected(int index);
     void onOverlayGlyphSelected(int index);
     void onMapEntrySelected(int blockIndex, int entryIndex);
-    void onGlyphModified();
-    void onMapModified();
+    void onMapEntryChanged(int blockIndex, int entryIndex);
+    void onMapStructureChanged();
+    void onReferenceResolved(uint32_t cp);
     void zoomIn();
     void zoomOut();
     void zoomReset();
     void showColorSettings();
+    void showScreenSimulator();
+    void setHistoryBudget();
+    void mergeDuplicateGlyphs();
     void onFlagToggled();
 
 private:
@@ -46,12 +68,29 @@ private:
     void updateTitle();
     void updateComposite();
     void syncFlagControls(const UnicodeMapEntry &entry);
+    void showReference(uint32_t cp, const CodepointReference &ref);
+    void endLoad();
     bool maybeSave();
+    // Starts a background save; onFontSaved() adopts path if it succeeds
+    void saveTo(const QString &path);
+    // Applies op to the glyphs selected in that layer's grid, as one undo step
+    void transformGlyphs(GlyphEditCommand::Layer layer, GlyphTransform::Operation op, const QString &name);
 
     UlfFont m_font;
     QString m_filePath;
+    FontNotifier *m_fontNotifier;
     ColorSettings *m_colorSettings;
     QUndoStack *m_undoStack;
+    ReferenceResolver *m_refResolver;
+    FontLoader *m_loader;
+    FontSaver *m_saver;
+    EditJournal *m_journal;
+    QProgressBar *m_loadProgress;
+    // Disabled while a load runs
+    QList<QAction *> m_fontActions;
+    QAction *m_undoAction;
+    QAction *m_redoAction;
+    QToolButton *m_loadCancel;
 
     // Unicode map
     UnicodeMapEditor *m_mapEditor;
@@ -76,10 +115,13 @@ private:
     QCheckBox *m_vflipCheck;
     QCheckBox *m_noGlyphCheck;
     TextPreview *m_textPreview;
-    QLineEdit *m_textInput;
+    QPlainTextEdit *m_textInput;
+    QTimer *m_textTimer;
+    ScreenSimulatorWindow *m_simulator = nullptr;  // created on first use
 
     // Currently selected map entry
     int m_selBlock = -1;
     int m_selEntry = -1;
+    int64_t m_refCodepoint = -1;  // shown (or awaited) in the reference pane
     bool m_updatingFlags = false;
 };
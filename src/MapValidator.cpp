@@ -0,0 +1,148 @@
+#include "MapValidator.h"
+#include "UlfFont.h"
+#include <algorithm>
+
+namespace {
+
+constexpr unsigned LAYOUT_ISSUES = MapValidator::Overlap | MapValidator::OutOfOrder;
+
+} // namespace
+
+void MapValidator::setFont(const UlfFont *font)
+{
+    m_font = font;
+    revalidate();
+}
+
+void MapValidator::revalidate()
+{
+    m_blocks.clear();
+    if (!m_font)
+        return;
+    m_blocks.resize(m_font->unicodeMap.size());
+    for (int bi = 0; bi < (int)m_blocks.size(); ++bi)
+        scanBlock(bi);
+    checkLayout();
+}
+
+void MapValidator::blockInserted(int blockIndex)
+{
+    m_blocks.insert(m_blocks.begin() + blockIndex, BlockState());
+    scanBlock(blockIndex);
+    checkLayout();
+}
+
+void MapValidator::blockRemoved(int blockIndex)
+{
+    m_blocks.erase(m_blocks.begin() + blockIndex);
+    checkLayout();
+}
+
+void MapValidator::blockChanged(int blockIndex)
+{
+    scanBlock(blockIndex);
+    checkLayout();
+}
+
+void MapValidator::entryChanged(int blockIndex, int entryIndex)
+{
+    // Only the entry's own fields changed; the block layout is unaffected
+    const auto &entry = m_font->unicodeMap[blockIndex].entries[entryIndex];
+    auto &state = m_blocks[blockIndex];
+    auto it = std::lower_bound(state.badEntries.begin(), state.badEntries.end(), entryIndex);
+    bool listed = it != state.badEntries.end() && *it == entryIndex;
+    bool bad = entry.overlayIndex >= UlfFont::OVERLAY_COUNT;
+    if (bad && !listed)
+        state.badEntries.insert(it, entryIndex);
+    else if (!bad && listed)
+        state.badEntries.erase(it);
+
+    if (state.badEntries.empty())
+        state.issues &= ~BadOverlay;
+    else
+        state.issues |= BadOverlay;
+}
+
+unsigned MapValidator::issues(int blockIndex) const
+{
+    if (blockIndex < 0 || blockIndex >= (int)m_blocks.size())
+        return 0;
+    return m_blocks[blockIndex].issues;
+}
+
+bool MapValidator::entryValid(int blockIndex, int entryIndex) const
+{
+    if (blockIndex < 0 || blockIndex >= (int)m_blocks.size())
+        return true;
+    const auto &bad = m_blocks[blockIndex].badEntries;
+    return !std::binary_search(bad.begin(), bad.end(), entryIndex);
+}
+
+int MapValidator::problemBlockCount() const
+{
+    return (int)std::count_if(m_blocks.begin(), m_blocks.end(),
+        [](const BlockState &state) { return state.issues != 0; });
+}
+
+void MapValidator::scanBlock(int blockIndex)
+{
+    const auto &block = m_font->unicodeMap[blockIndex];
+    auto &state = m_blocks[blockIndex];
+    state.issues &= LAYOUT_ISSUES;
+    state.badEntries.clear();
+
+    int count = (int)block.entries.size();
+    for (int ei = 0; ei < count; ++ei) {
+        if (block.entries[ei].overlayIndex >= UlfFont::OVERLAY_COUNT)
+            state.badEntries.push_back(ei);
+    }
+
+    if (!state.badEntries.empty())
+        state.issues |= BadOverlay;
+    if (count == 0)
+        state.issues |= Empty;
+    if (count > UlfFont::MAX_BLOCK_ENTRIES)
+        state.issues |= Oversized;
+    if ((uint64_t)block.startCodepoint + count > CODEPOINT_LIMIT)
+        state.issues |= OutOfRange;
+}
+
+void MapValidator::checkLayout()
+{
+    const auto &map = m_font->unicodeMap;
+    int n = (int)map.size();
+    for (auto &state : m_blocks)
+        state.issues &= ~LAYOUT_ISSUES;
+
+    for (int bi = 1; bi < n; ++bi) {
+        if (map[bi].startCodepoint < map[bi - 1].startCodepoint)
+            m_blocks[bi].issues |= OutOfOrder;
+    }
+
+    // Sort non-empty blocks by start. A block overlaps an earlier one if it
+    // starts below the furthest end seen so far, and a later one if the
+    // next start falls inside it.
+    std::vector<int> order;
+    order.reserve(n);
+    for (int bi = 0; bi < n; ++bi) {
+        if (!map[bi].entries.empty())
+            order.push_back(bi);
+    }
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        return map[a].startCodepoint < map[b].startCodepoint;
+    });
+
+    auto blockEnd = [&](int bi) {
+        return (uint64_t)map[bi].startCodepoint + map[bi].entries.size();
+    };
+    uint64_t furthest = 0;
+    for (int i = 0; i < (int)order.size(); ++i) {
+        int bi = order[i];
+        bool overlaps = i > 0 && map[bi].startCodepoint < furthest;
+        if (i + 1 < (int)order.size() && map[order[i + 1]].startCodepoint < blockEnd(bi))
+            overlaps = true;
+        if (overlaps)
+            m_blocks[bi].issues |= Overlap;
+        furthest = std::max(furthest, blockEnd(bi));
+    }
+}
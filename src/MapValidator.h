@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+class UlfFont;
+
+// Integrity checks over UlfFont::unicodeMap. A full pass is O(n log n) in
+// the number of blocks plus one look at every entry; the notification
+// calls below keep the results current without rescanning the whole map.
+class MapValidator {
+public:
+    enum Issue : unsigned {
+        Overlap = 1 << 0,     // shares codepoints with another block
+        OutOfOrder = 1 << 1,  // starts below the block before it
+        Oversized = 1 << 2,   // more entries than one on-disk block (split on save)
+        Empty = 1 << 3,       // no entries (dropped on save)
+        BadOverlay = 1 << 4,  // an entry's overlay index is out of range
+        OutOfRange = 1 << 5,  // extends past the last Unicode codepoint
+    };
+
+    static constexpr uint32_t CODEPOINT_LIMIT = 0x110000;
+
+    void setFont(const UlfFont *font);
+    void revalidate();
+
+    // Call after the map changed
+    void blockInserted(int blockIndex);
+    void blockRemoved(int blockIndex);
+    void blockChanged(int blockIndex);  // start or entry count changed
+    void entryChanged(int blockIndex, int entryIndex);
+
+    unsigned issues(int blockIndex) const;
+    bool entryValid(int blockIndex, int entryIndex) const;
+    int problemBlockCount() const;
+    bool isClean() const { return problemBlockCount() == 0; }
+
+private:
+    struct BlockState {
+        unsigned issues = 0;
+        std::vector<int> badEntries;  // sorted
+    };
+
+    void scanBlock(int blockIndex);
+    void checkLayout();
+
+    const UlfFont *m_font = nullptr;
+    std::vector<BlockState> m_blocks;
+};
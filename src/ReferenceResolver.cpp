@@ -0,0 +1,125 @@
+#include "ReferenceResolver.h"
+#include "UnicodeInfo.h"
+#include <QMutexLocker>
+#include <algorithm>
+
+ReferenceResolver::ReferenceResolver(QObject *parent)
+    : QObject(parent)
+{
+    m_thread.setObjectName(QStringLiteral("ReferenceResolver"));
+    m_worker = new QObject;
+    m_worker->moveToThread(&m_thread);
+    connect(&m_thread, &QThread::finished, m_worker, &QObject::deleteLater);
+    m_thread.start(QThread::LowPriority);
+}
+
+ReferenceResolver::~ReferenceResolver()
+{
+    m_stopping = true;
+    m_thread.quit();
+    m_thread.wait();
+}
+
+const CodepointReference *ReferenceResolver::find(uint32_t cp) const
+{
+    auto it = m_cache.constFind(cp);
+    return it != m_cache.constEnd() ? &it.value() : nullptr;
+}
+
+void ReferenceResolver::request(uint32_t cp)
+{
+    if (m_cache.contains(cp))
+        return;
+    {
+        QMutexLocker lock(&m_mutex);
+        if (m_urgent >= 0)
+            m_pending.remove((uint32_t)m_urgent);
+        if (m_pending.contains(cp)) {
+            // Already queued for prefetch; move it to the front
+            auto it = std::find(m_prefetch.begin(), m_prefetch.end(), cp);
+            if (it == m_prefetch.end()) {
+                m_urgent = -1;
+                return;  // being resolved right now
+            }
+            m_prefetch.erase(it);
+        }
+        m_urgent = cp;
+        m_pending.insert(cp);
+    }
+    wakeWorker();
+}
+
+void ReferenceResolver::prefetch(uint32_t first, uint32_t count)
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        for (uint32_t cp = first; cp - first < count; ++cp) {
+            if (!m_cache.contains(cp) && !m_pending.contains(cp)) {
+                m_prefetch.push_back(cp);
+                m_pending.insert(cp);
+            }
+        }
+    }
+    wakeWorker();
+}
+
+void ReferenceResolver::wakeWorker()
+{
+    QMutexLocker lock(&m_mutex);
+    if (m_draining)
+        return;
+    m_draining = true;
+    QMetaObject::invokeMethod(m_worker, [this]() { drain(); }, Qt::QueuedConnection);
+}
+
+bool ReferenceResolver::takeNext(uint32_t &cp)
+{
+    QMutexLocker lock(&m_mutex);
+    if (m_urgent >= 0) {
+        cp = (uint32_t)m_urgent;
+        m_urgent = -1;
+        return true;
+    }
+    if (!m_prefetch.empty()) {
+        cp = m_prefetch.front();
+        m_prefetch.pop_front();
+        return true;
+    }
+    m_draining = false;
+    return false;
+}
+
+void ReferenceResolver::drain()
+{
+    uint32_t cp;
+    while (!m_stopping && takeNext(cp)) {
+        CodepointReference ref;
+        ref.character = unicodeCharStr(cp);
+        ref.blockName = unicodeBlockName(cp);
+        ref.name = unicodeCharName(cp);
+        ref.fallbackFamily = fontForCodepoint(cp);
+
+        QMutexLocker lock(&m_mutex);
+        m_results.emplace_back(cp, std::move(ref));
+        if (!m_collecting) {
+            m_collecting = true;
+            QMetaObject::invokeMethod(this, [this]() { collectResults(); }, Qt::QueuedConnection);
+        }
+    }
+}
+
+void ReferenceResolver::collectResults()
+{
+    std::vector<std::pair<uint32_t, CodepointReference>> results;
+    {
+        QMutexLocker lock(&m_mutex);
+        results.swap(m_results);
+        m_collecting = false;
+        for (const auto &result : results)
+            m_pending.remove(result.first);
+    }
+    for (auto &result : results) {
+        m_cache.insert(result.first, std::move(result.second));
+        emit resolved(result.first);
+    }
+}
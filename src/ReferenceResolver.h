@@ -0,0 +1,61 @@
+#pragma once
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QThread>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// What the reference pane shows for a codepoint
+struct CodepointReference {
+    QString character;
+    QString blockName;
+    QString name;
+    QString fallbackFamily;  // font to draw character with, empty for the default
+};
+
+// Resolves codepoint references on a worker thread and keeps every answer
+// for the rest of the session. request() is for the current selection and
+// replaces any earlier request still waiting; prefetch() queues behind it.
+class ReferenceResolver : public QObject {
+    Q_OBJECT
+public:
+    explicit ReferenceResolver(QObject *parent = nullptr);
+    ~ReferenceResolver() override;
+
+    // Cached reference, or nullptr if it hasn't been resolved yet
+    const CodepointReference *find(uint32_t cp) const;
+
+    void request(uint32_t cp);
+    void prefetch(uint32_t first, uint32_t count);
+
+signals:
+    // A reference has just been added to the cache
+    void resolved(uint32_t cp);
+
+private:
+    void wakeWorker();
+    void collectResults();
+    // Worker thread
+    void drain();
+    bool takeNext(uint32_t &cp);
+
+    QHash<uint32_t, CodepointReference> m_cache;  // UI thread only
+
+    // Shared with the worker
+    QMutex m_mutex;
+    int64_t m_urgent = -1;
+    std::deque<uint32_t> m_prefetch;
+    QSet<uint32_t> m_pending;  // queued or being resolved
+    std::vector<std::pair<uint32_t, CodepointReference>> m_results;
+    bool m_draining = false;
+    bool m_collecting = false;
+    std::atomic<bool> m_stopping{false};
+
+    QThread m_thread;
+    QObject *m_worker = nullptr;  // lives on m_thread; context for drain()
+};
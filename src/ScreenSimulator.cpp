@@ -0,0 +1,505 @@
+#include "ScreenSimulator.h"
+#include "FontNotifier.h"
+#include <QComboBox>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QPainter>
+#include <QPaintEvent>
+#include <QTimer>
+#include <QVBoxLayout>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Default X16 palette entries 0-15 (12-bit VERA colors)
+static const QRgb X16_PALETTE[16] = {
+    0xff000000, 0xffffffff, 0xff880000, 0xffaaffee,
+    0xffcc44cc, 0xff00cc55, 0xff0000aa, 0xffeeee77,
+    0xffdd8855, 0xff664400, 0xffff7777, 0xff333333,
+    0xff777777, 0xffaaff66, 0xff0088ff, 0xffbbbbbb,
+};
+
+// Weight of the newest frame in the smoothed timings
+static constexpr double SMOOTHING = 0.1;
+
+static double smooth(double average, double sample)
+{
+    return average == 0 ? sample : average + (sample - average) * SMOOTHING;
+}
+
+ScreenSimulator::ScreenSimulator(QWidget *parent)
+    : QWidget(parent)
+{
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    setMinimumSize(320, 240);
+    onColorsChanged();
+    setScreenSize(m_columns, m_rows);
+    m_clock.start();
+}
+
+void ScreenSimulator::setFont(UlfFont *font)
+{
+    if (m_font && m_font->notifier())
+        disconnect(m_font->notifier(), nullptr, this, nullptr);
+    m_font = font;
+    if (FontNotifier *notifier = m_font ? m_font->notifier() : nullptr) {
+        connect(notifier, &FontNotifier::baseGlyphChanged, this, &ScreenSimulator::onBaseGlyphChanged);
+        connect(notifier, &FontNotifier::overlayGlyphChanged, this, &ScreenSimulator::onOverlayGlyphChanged);
+        connect(notifier, &FontNotifier::mapRangeChanged, this, &ScreenSimulator::onMapRangeChanged);
+        connect(notifier, &FontNotifier::fontReset, this, &ScreenSimulator::onFontReset);
+    }
+    onFontReset();
+}
+
+void ScreenSimulator::setColorSettings(ColorSettings *cs)
+{
+    if (m_colorSettings)
+        disconnect(m_colorSettings, nullptr, this, nullptr);
+    m_colorSettings = cs;
+    if (m_colorSettings)
+        connect(m_colorSettings, &ColorSettings::colorsChanged, this, &ScreenSimulator::onColorsChanged);
+    onColorsChanged();
+}
+
+void ScreenSimulator::setScreenSize(int columns, int rows)
+{
+    m_columns = columns;
+    m_rows = rows;
+    int count = columns * rows;
+    m_cells.assign(count, Cell());
+    m_cellGlyphs.assign(count, CellGlyph());
+    m_dirty.assign(count, 0);
+    m_frame = QImage(columns * UlfFont::GLYPH_W, rows * UlfFont::GLYPH_H, QImage::Format_RGB32);
+    m_target = targetRect();
+    for (int i = 0; i < count; ++i)
+        resolve(i);
+    markAllDirty();
+    updateGeometry();
+}
+
+void ScreenSimulator::setCell(int column, int row, uint32_t codepoint, uint8_t color)
+{
+    int index = row * m_columns + column;
+    Cell &cell = m_cells[index];
+    if (cell.codepoint == codepoint && cell.color == color)
+        return;
+    bool resolveNeeded = cell.codepoint != codepoint;
+    cell.codepoint = codepoint;
+    cell.color = color;
+    if (resolveNeeded)
+        resolve(index);
+    markDirty(index);
+}
+
+void ScreenSimulator::clear(uint8_t color)
+{
+    for (int row = 0; row < m_rows; ++row)
+        for (int column = 0; column < m_columns; ++column)
+            setCell(column, row, ' ', color);
+}
+
+void ScreenSimulator::scrollUp(int lines, uint8_t color)
+{
+    lines = qBound(0, lines, m_rows);
+    if (lines == 0)
+        return;
+
+    // Cells, their state and the rendered pixels all move together, so only
+    // the exposed rows need rendering afterwards
+    size_t shift = (size_t)lines * m_columns;
+    size_t keep = m_cells.size() - shift;
+    std::move(m_cells.begin() + shift, m_cells.end(), m_cells.begin());
+    std::move(m_cellGlyphs.begin() + shift, m_cellGlyphs.end(), m_cellGlyphs.begin());
+    std::memmove(m_dirty.data(), m_dirty.data() + shift, keep);
+    std::fill(m_cells.begin() + keep, m_cells.end(), Cell{' ', color});
+    std::fill(m_cellGlyphs.begin() + keep, m_cellGlyphs.end(), CellGlyph());
+    std::fill(m_dirty.begin() + keep, m_dirty.end(), 0);
+
+    size_t lineBytes = (size_t)m_frame.bytesPerLine() * UlfFont::GLYPH_H;
+    uchar *bits = m_frame.bits();
+    std::memmove(bits, bits + lineBytes * lines, lineBytes * (m_rows - lines));
+    m_dirtyCells = m_dirtyCells.translated(0, -lines) & QRect(0, 0, m_columns, m_rows);
+
+    for (size_t i = keep; i < m_cells.size(); ++i) {
+        resolve((int)i);
+        markDirty((int)i);
+    }
+    update(m_target);
+}
+
+QSize ScreenSimulator::sizeHint() const
+{
+    return m_frame.size();
+}
+
+void ScreenSimulator::onBaseGlyphChanged(int glyphIndex)
+{
+    for (size_t i = 0; i < m_cellGlyphs.size(); ++i) {
+        if (m_cellGlyphs[i].mapped && m_cellGlyphs[i].entry.baseIndex == glyphIndex)
+            markDirty((int)i);
+    }
+}
+
+void ScreenSimulator::onOverlayGlyphChanged(int glyphIndex)
+{
+    for (size_t i = 0; i < m_cellGlyphs.size(); ++i) {
+        if (m_cellGlyphs[i].mapped && m_cellGlyphs[i].entry.overlayIndex == glyphIndex)
+            markDirty((int)i);
+    }
+}
+
+void ScreenSimulator::onMapRangeChanged(uint32_t first, uint32_t last)
+{
+    for (size_t i = 0; i < m_cells.size(); ++i) {
+        if (m_cells[i].codepoint >= first && m_cells[i].codepoint <= last) {
+            resolve((int)i);
+            markDirty((int)i);
+        }
+    }
+}
+
+void ScreenSimulator::onFontReset()
+{
+    m_glyphs.clear();
+    for (size_t i = 0; i < m_cells.size(); ++i)
+        resolve((int)i);
+    markAllDirty();
+}
+
+void ScreenSimulator::onColorsChanged()
+{
+    QRgb ov1 = m_colorSettings ? m_colorSettings->overlayColor1().rgb() : qRgb(170, 0, 0);
+    QRgb ov2 = m_colorSettings ? m_colorSettings->overlayColor2().rgb() : qRgb(0, 170, 0);
+    for (int color = 0; color < 256; ++color) {
+        QRgb fg = X16_PALETTE[color & 15];
+        QRgb bg = X16_PALETTE[color >> 4];
+        QRgb *palette = m_palettes[color];
+        palette[0] = bg;
+        palette[1] = fg;
+        palette[2] = ov1;
+        palette[3] = ov2;
+        palette[4] = fg;
+    }
+    markAllDirty();
+}
+
+void ScreenSimulator::resolve(int index)
+{
+    const UnicodeMapEntry *entry = m_font ? m_font->findEntry(m_cells[index].codepoint) : nullptr;
+    CellGlyph &glyph = m_cellGlyphs[index];
+    glyph.mapped = entry != nullptr;
+    if (entry)
+        glyph.entry = *entry;
+}
+
+void ScreenSimulator::markDirty(int index)
+{
+    if (m_dirty[index])
+        return;
+    m_dirty[index] = 1;
+    // Bounds only grow until the next paint, so the pending update stays
+    // a single rectangle
+    QRect cell(index % m_columns, index / m_columns, 1, 1);
+    if (!m_dirtyCells.contains(cell)) {
+        m_dirtyCells |= cell;
+        update(widgetRect(m_dirtyCells));
+    }
+}
+
+void ScreenSimulator::markAllDirty()
+{
+    std::fill(m_dirty.begin(), m_dirty.end(), 1);
+    m_dirtyCells = QRect(0, 0, m_columns, m_rows);
+    update();
+}
+
+const ScreenSimulator::GlyphBitmap &ScreenSimulator::glyphBitmap(const UnicodeMapEntry &entry)
+{
+    uint64_t baseGeneration = m_font->baseGeneration(entry.baseIndex);
+    uint64_t overlayGeneration = entry.overlayIndex < UlfFont::OVERLAY_COUNT
+        ? m_font->overlayGeneration(entry.overlayIndex) : 0;
+
+    GlyphBitmap &glyph = m_glyphs[UlfFont::compositeKey(entry)];
+    if (glyph.baseGeneration != baseGeneration || glyph.overlayGeneration != overlayGeneration) {
+        const uint32_t *rows = m_font->cachedComposite(entry);
+        for (int y = 0; y < UlfFont::GLYPH_H; ++y)
+            for (int x = 0; x < UlfFont::GLYPH_W; ++x)
+                glyph.pixels[y][x] = uchar(UlfFont::packedPixel(rows, x, y));
+        glyph.baseGeneration = baseGeneration;
+        glyph.overlayGeneration = overlayGeneration;
+    }
+    return glyph;
+}
+
+void ScreenSimulator::renderCell(int index)
+{
+    const QRgb *palette = m_palettes[m_cells[index].color];
+    int x = (index % m_columns) * UlfFont::GLYPH_W;
+    int y = (index / m_columns) * UlfFont::GLYPH_H;
+    uchar *bits = m_frame.bits();
+    qsizetype stride = m_frame.bytesPerLine();
+
+    const CellGlyph &cellGlyph = m_cellGlyphs[index];
+    if (!cellGlyph.mapped) {
+        for (int gy = 0; gy < UlfFont::GLYPH_H; ++gy)
+            std::fill_n(reinterpret_cast<QRgb *>(bits + (y + gy) * stride) + x, UlfFont::GLYPH_W, palette[0]);
+        return;
+    }
+    const GlyphBitmap &glyph = glyphBitmap(cellGlyph.entry);
+    for (int gy = 0; gy < UlfFont::GLYPH_H; ++gy) {
+        QRgb *line = reinterpret_cast<QRgb *>(bits + (y + gy) * stride) + x;
+        for (int gx = 0; gx < UlfFont::GLYPH_W; ++gx)
+            line[gx] = palette[glyph.pixels[gy][gx]];
+    }
+}
+
+QRect ScreenSimulator::targetRect() const
+{
+    // Largest integer scale that fits, or shrink to fit in a small window
+    QSize frame = m_frame.size();
+    double scale = qMin(width() / (double)frame.width(), height() / (double)frame.height());
+    if (scale >= 1)
+        scale = std::floor(scale);
+    QSize size = (QSizeF(frame) * scale).toSize();
+    return QRect((width() - size.width()) / 2, (height() - size.height()) / 2,
+                 size.width(), size.height());
+}
+
+QRect ScreenSimulator::widgetRect(const QRect &cells) const
+{
+    double sx = m_target.width() / (double)m_frame.width();
+    double sy = m_target.height() / (double)m_frame.height();
+    QRectF r(m_target.x() + cells.x() * UlfFont::GLYPH_W * sx,
+             m_target.y() + cells.y() * UlfFont::GLYPH_H * sy,
+             cells.width() * UlfFont::GLYPH_W * sx,
+             cells.height() * UlfFont::GLYPH_H * sy);
+    return r.toAlignedRect();
+}
+
+void ScreenSimulator::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    m_target = targetRect();
+}
+
+void ScreenSimulator::paintEvent(QPaintEvent *event)
+{
+    QElapsedTimer render;
+    render.start();
+
+    int rendered = 0;
+    if (m_font && !m_dirtyCells.isEmpty()) {
+        for (int row = m_dirtyCells.top(); row <= m_dirtyCells.bottom(); ++row) {
+            int index = row * m_columns + m_dirtyCells.left();
+            for (int column = m_dirtyCells.left(); column <= m_dirtyCells.right(); ++column, ++index) {
+                if (m_dirty[index]) {
+                    renderCell(index);
+                    m_dirty[index] = 0;
+                    ++rendered;
+                }
+            }
+        }
+        m_dirtyCells = QRect();
+    } else if (!m_font) {
+        m_frame.fill(X16_PALETTE[DEFAULT_COLOR >> 4]);
+    }
+
+    QPainter p(this);
+    for (const QRect &r : event->region().subtracted(m_target))
+        p.fillRect(r, Qt::black);
+    p.drawImage(m_target, m_frame);
+    p.end();
+
+    qint64 now = m_clock.nsecsElapsed();
+    // A long gap means nothing was animating; don't average it in
+    if (m_lastPaint >= 0 && now - m_lastPaint < 250000000)
+        m_frameTime = smooth(m_frameTime, (now - m_lastPaint) / 1e6);
+    m_lastPaint = now;
+    m_renderTime = smooth(m_renderTime, render.nsecsElapsed() / 1e6);
+    m_cellsRendered = rendered;
+}
+
+// --- Window ---
+
+static const struct {
+    int columns;
+    int rows;
+} SCREEN_MODES[] = {
+    {80, 60},
+    {80, 30},
+    {40, 30},
+};
+
+ScreenSimulatorWindow::ScreenSimulatorWindow(UlfFont *font, ColorSettings *cs, QWidget *parent)
+    : QWidget(parent, Qt::Window), m_font(font)
+{
+    setWindowTitle(tr("X16 Screen Simulator"));
+
+    m_screen = new ScreenSimulator;
+    m_screen->setFont(font);
+    m_screen->setColorSettings(cs);
+
+    m_modeCombo = new QComboBox;
+    for (const auto &mode : SCREEN_MODES)
+        m_modeCombo->addItem(tr("%1 x %2").arg(mode.columns).arg(mode.rows));
+    m_workloadCombo = new QComboBox;
+    m_workloadCombo->addItem(tr("Static text"));
+    m_workloadCombo->addItem(tr("Scroll a line per frame"));
+    m_workloadCombo->addItem(tr("Redraw every cell per frame"));
+    m_statsLabel = new QLabel;
+    m_statsLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+
+    auto *controls = new QHBoxLayout;
+    controls->addWidget(new QLabel(tr("Screen:")));
+    controls->addWidget(m_modeCombo);
+    controls->addWidget(new QLabel(tr("Workload:")));
+    controls->addWidget(m_workloadCombo);
+    controls->addStretch(1);
+    controls->addWidget(m_statsLabel);
+
+    auto *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(4, 4, 4, 4);
+    layout->addLayout(controls);
+    layout->addWidget(m_screen, 1);
+
+    // Ticks at display rate; the stats show what the paints actually achieve
+    m_frameTimer = new QTimer(this);
+    m_frameTimer->setTimerType(Qt::PreciseTimer);
+    m_frameTimer->setInterval(1000 / 60);
+    connect(m_frameTimer, &QTimer::timeout, this, &ScreenSimulatorWindow::step);
+    m_statsTimer = new QTimer(this);
+    m_statsTimer->setInterval(250);
+    connect(m_statsTimer, &QTimer::timeout, this, &ScreenSimulatorWindow::updateStats);
+
+    connect(m_modeCombo, &QComboBox::currentIndexChanged, this, &ScreenSimulatorWindow::setMode);
+    connect(m_workloadCombo, &QComboBox::currentIndexChanged, this, &ScreenSimulatorWindow::setWorkload);
+
+    resize(800, 640);
+    setMode(0);
+}
+
+void ScreenSimulatorWindow::setText(const QString &text)
+{
+    m_text.clear();
+    m_text.reserve(text.size());
+    const QChar *p = text.constData();
+    const QChar *end = p + text.size();
+    while (p < end) {
+        uint32_t cp = p->unicode();
+        ++p;
+        if (QChar::isHighSurrogate(cp) && p < end && p->isLowSurrogate()) {
+            cp = QChar::surrogateToUcs4(char16_t(cp), p->unicode());
+            ++p;
+        }
+        if (cp == '\r' || cp == 0x2029) {
+            if (cp == '\r' && p < end && *p == QLatin1Char('\n'))
+                ++p;
+            cp = '\n';
+        }
+        m_text.push_back(cp);
+    }
+    m_textPos = 0;
+    if (m_workloadCombo->currentIndex() == Idle)
+        fillScreen();
+}
+
+const std::vector<uint32_t> &ScreenSimulatorWindow::source()
+{
+    if (!m_text.empty())
+        return m_text;
+    if (m_font->version() == m_mapVersion && !m_mapText.empty())
+        return m_mapText;
+    // Every mapped codepoint, a line per map block
+    m_mapVersion = m_font->version();
+    m_mapText.clear();
+    for (const auto &block : m_font->unicodeMap) {
+        for (size_t i = 0; i < block.entries.size(); ++i)
+            m_mapText.push_back(block.startCodepoint + (uint32_t)i);
+        m_mapText.push_back('\n');
+    }
+    if (m_mapText.empty())
+        m_mapText.push_back('\n');
+    return m_mapText;
+}
+
+void ScreenSimulatorWindow::setMode(int index)
+{
+    m_screen->setScreenSize(SCREEN_MODES[index].columns, SCREEN_MODES[index].rows);
+    m_textPos = 0;
+    fillScreen();
+}
+
+void ScreenSimulatorWindow::setWorkload(int index)
+{
+    m_tick = 0;
+    if (index == Idle) {
+        m_frameTimer->stop();
+        m_statsTimer->stop();
+        m_statsLabel->clear();
+        m_textPos = 0;
+        fillScreen();
+    } else {
+        m_frameTimer->start();
+        m_statsTimer->start();
+    }
+}
+
+void ScreenSimulatorWindow::fillScreen()
+{
+    for (int row = 0; row < m_screen->rows(); ++row)
+        writeLine(row);
+}
+
+void ScreenSimulatorWindow::writeLine(int row)
+{
+    // Wraps at the last column like the X16 screen editor
+    const std::vector<uint32_t> &text = source();
+    if (m_textPos >= text.size())
+        m_textPos = 0;
+    int column = 0;
+    while (column < m_screen->columns() && m_textPos < text.size()) {
+        uint32_t cp = text[m_textPos];
+        if (cp == '\n')
+            break;
+        m_screen->setCell(column++, row, cp, ScreenSimulator::DEFAULT_COLOR);
+        ++m_textPos;
+    }
+    if (m_textPos < text.size() && text[m_textPos] == '\n')
+        ++m_textPos;
+    for (; column < m_screen->columns(); ++column)
+        m_screen->setCell(column, row, ' ', ScreenSimulator::DEFAULT_COLOR);
+}
+
+void ScreenSimulatorWindow::step()
+{
+    ++m_tick;
+    if (m_workloadCombo->currentIndex() == Scroll) {
+        m_screen->scrollUp(1);
+        writeLine(m_screen->rows() - 1);
+        return;
+    }
+
+    // Every cell gets a new codepoint and color each frame
+    const std::vector<uint32_t> &text = source();
+    int columns = m_screen->columns();
+    for (int row = 0; row < m_screen->rows(); ++row) {
+        for (int column = 0; column < columns; ++column) {
+            uint32_t cp = text[(m_textPos + row * columns + column) % text.size()];
+            int fg = (row + m_tick) & 15;
+            if (fg == 6)
+                fg = 1;
+            m_screen->setCell(column, row, cp == '\n' ? ' ' : cp, uint8_t(0x60 | fg));
+        }
+    }
+    ++m_textPos;
+}
+
+void ScreenSimulatorWindow::updateStats()
+{
+    double frame = m_screen->frameTime();
+    m_statsLabel->setText(tr("Frame %1 ms (%2 fps), render %3 ms, %4 cells")
+                              .arg(frame, 0, 'f', 1)
+                              .arg(frame > 0 ? 1000 / frame : 0, 0, 'f', 1)
+                              .arg(m_screen->renderTime(), 0, 'f', 2)
+                              .arg(m_screen->cellsRendered()));
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include <QElapsedTimer>
+#include <QHash>
+#include <QImage>
+#include <QWidget>
+#include <vector>
+#include "ColorSettings.h"
+#include "UlfFont.h"
+
+class QComboBox;
+class QLabel;
+class QTimer;
+
+// X16 text screen: a grid of codepoint + color cells drawn with the font the
+// way the machine would. Only cells that changed since the last frame are
+// re-rendered into the 1x frame; scrolling moves the frame's pixels instead.
+class ScreenSimulator : public QWidget {
+    Q_OBJECT
+public:
+    // VERA text mode attribute: background in the high nibble, foreground
+    // in the low one, both indices into the default X16 palette
+    static constexpr uint8_t DEFAULT_COLOR = 0x61;  // white on blue
+
+    struct Cell {
+        uint32_t codepoint = ' ';
+        uint8_t color = DEFAULT_COLOR;
+    };
+
+    explicit ScreenSimulator(QWidget *parent = nullptr);
+
+    void setFont(UlfFont *font);
+    void setColorSettings(ColorSettings *cs);
+
+    void setScreenSize(int columns, int rows);
+    int columns() const { return m_columns; }
+    int rows() const { return m_rows; }
+
+    const Cell &cell(int column, int row) const { return m_cells[row * m_columns + column]; }
+    void setCell(int column, int row, uint32_t codepoint, uint8_t color);
+    void clear(uint8_t color = DEFAULT_COLOR);
+    // Move everything up, leaving blank rows in color at the bottom
+    void scrollUp(int lines, uint8_t color = DEFAULT_COLOR);
+
+    // Smoothed over recent frames: time between painted frames, time spent
+    // in paintEvent, and the cells re-rendered by the last one
+    double frameTime() const { return m_frameTime; }
+    double renderTime() const { return m_renderTime; }
+    int cellsRendered() const { return m_cellsRendered; }
+
+    QSize sizeHint() const override;
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+
+private:
+    // Glyph cell at 1x, color indices as in UlfFont::packedPixel
+    struct GlyphBitmap {
+        uint64_t baseGeneration = ~uint64_t(0);  // not rendered yet
+        uint64_t overlayGeneration = 0;
+        uchar pixels[UlfFont::GLYPH_H][UlfFont::GLYPH_W];
+    };
+    // Map entry a cell's codepoint resolved to, if any
+    struct CellGlyph {
+        UnicodeMapEntry entry;
+        bool mapped = false;
+    };
+
+    void onBaseGlyphChanged(int glyphIndex);
+    void onOverlayGlyphChanged(int glyphIndex);
+    void onMapRangeChanged(uint32_t first, uint32_t last);
+    void onFontReset();
+    void onColorsChanged();
+
+    void resolve(int index);
+    void markDirty(int index);
+    void markAllDirty();
+    void renderCell(int index);
+    const GlyphBitmap &glyphBitmap(const UnicodeMapEntry &entry);
+    QRect targetRect() const;
+    QRect widgetRect(const QRect &cells) const;
+
+    UlfFont *m_font = nullptr;
+    ColorSettings *m_colorSettings = nullptr;
+
+    int m_columns = 80;
+    int m_rows = 60;
+    std::vector<Cell> m_cells;
+    std::vector<CellGlyph> m_cellGlyphs;
+    std::vector<uint8_t> m_dirty;
+    QRect m_dirtyCells;  // bounds of m_dirty, in cells
+
+    QHash<uint32_t, GlyphBitmap> m_glyphs;  // by UlfFont::compositeKey
+    // Composite pixel id to screen color, per attribute byte
+    QRgb m_palettes[256][ColorSettings::COMPOSITE_COLORS];
+    QImage m_frame;  // RGB32 at 1x
+    QRect m_target;  // where m_frame is drawn
+
+    QElapsedTimer m_clock;
+    qint64 m_lastPaint = -1;
+    double m_frameTime = 0;
+    double m_renderTime = 0;
+    int m_cellsRendered = 0;
+};
+
+// Window around a ScreenSimulator with terminal-like workloads to run on it
+class ScreenSimulatorWindow : public QWidget {
+    Q_OBJECT
+public:
+    ScreenSimulatorWindow(UlfFont *font, ColorSettings *cs, QWidget *parent = nullptr);
+
+    // Text the workloads draw from; the font's mapped codepoints when empty
+    void setText(const QString &text);
+
+private:
+    enum Workload { Idle, Scroll, Redraw };
+
+    void setMode(int index);
+    void setWorkload(int index);
+    void step();
+    void updateStats();
+    void fillScreen();
+    void writeLine(int row);
+    const std::vector<uint32_t> &source();
+
+    UlfFont *m_font;
+    ScreenSimulator *m_screen;
+    QComboBox *m_modeCombo;
+    QComboBox *m_workloadCombo;
+    QLabel *m_statsLabel;
+    QTimer *m_frameTimer;
+    QTimer *m_statsTimer;
+
+    std::vector<uint32_t> m_text;  // lines separated by '\n'
+    std::vector<uint32_t> m_mapText;
+    uint64_t m_mapVersion = 0;  // font version m_mapText was built from
+    size_t m_textPos = 0;
+    int m_tick = 0;
+};
@@ -0,0 +1,250 @@
+#include "TextPreview.h"
+#include "ColorSettings.h"
+#include "FontNotifier.h"
+#include <QPainter>
+#include <QScrollBar>
+#include <algorithm>
+#include <cstring>
+
+static constexpr int MARGIN = 2;
+
+TextPreview::TextPreview(QWidget *parent)
+    : QAbstractScrollArea(parent)
+{
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    setMinimumHeight(UlfFont::GLYPH_H * m_scale + 2 * MARGIN + 2 * frameWidth());
+    m_paragraphStarts = {0, 0};
+    relayout();
+}
+
+void TextPreview::setFont(UlfFont *font)
+{
+    if (m_font && m_font->notifier())
+        disconnect(m_font->notifier(), nullptr, this, nullptr);
+    m_font = font;
+    if (FontNotifier *notifier = m_font ? m_font->notifier() : nullptr) {
+        connect(notifier, &FontNotifier::baseGlyphChanged, this, &TextPreview::onBaseGlyphChanged);
+        connect(notifier, &FontNotifier::overlayGlyphChanged, this, &TextPreview::onOverlayGlyphChanged);
+        connect(notifier, &FontNotifier::mapRangeChanged, this, &TextPreview::onMapRangeChanged);
+        connect(notifier, &FontNotifier::fontReset, this, &TextPreview::onFontReset);
+    }
+    onFontReset();
+}
+
+void TextPreview::setColorSettings(ColorSettings *cs)
+{
+    if (m_colorSettings)
+        disconnect(m_colorSettings, nullptr, this, nullptr);
+    m_colorSettings = cs;
+    if (m_colorSettings)
+        connect(m_colorSettings, &ColorSettings::colorsChanged, this, &TextPreview::refresh);
+    refresh();
+}
+
+void TextPreview::setText(const QString &text)
+{
+    // One pass over the UTF-16: decode, and split paragraphs at \n, \r\n,
+    // \r and U+2029
+    m_codepoints.clear();
+    m_codepoints.reserve(text.size());
+    // The painted range is only known again at the next paint
+    m_frameFirst = m_frameLast = 0;
+    m_paragraphStarts.clear();
+    m_paragraphStarts.push_back(0);
+
+    const QChar *p = text.constData();
+    const QChar *end = p + text.size();
+    while (p < end) {
+        uint32_t cp = p->unicode();
+        ++p;
+        if (QChar::isHighSurrogate(cp) && p < end && p->isLowSurrogate()) {
+            cp = QChar::surrogateToUcs4(char16_t(cp), p->unicode());
+            ++p;
+        }
+        if (cp == '\r' || cp == '\n' || cp == 0x2029) {
+            if (cp == '\r' && p < end && *p == QLatin1Char('\n'))
+                ++p;
+            m_paragraphStarts.push_back((uint32_t)m_codepoints.size());
+            continue;
+        }
+        m_codepoints.push_back(cp);
+    }
+    m_paragraphStarts.push_back((uint32_t)m_codepoints.size());
+
+    // The scroll position stays put (clamped), so editing a long document
+    // doesn't jump back to the top
+    relayout();
+    viewport()->update();
+}
+
+void TextPreview::refresh()
+{
+    viewport()->update();
+}
+
+QSize TextPreview::sizeHint() const
+{
+    return QSize(400, 4 * UlfFont::GLYPH_H * m_scale + 2 * MARGIN + 2 * frameWidth());
+}
+
+void TextPreview::onBaseGlyphChanged(int glyphIndex)
+{
+    if (m_usedBase[glyphIndex])
+        viewport()->update();
+}
+
+void TextPreview::onOverlayGlyphChanged(int glyphIndex)
+{
+    if (m_usedOverlay[glyphIndex])
+        viewport()->update();
+}
+
+void TextPreview::onMapRangeChanged(uint32_t first, uint32_t last)
+{
+    uint32_t frameLast = qMin(m_frameLast, (uint32_t)m_codepoints.size());
+    for (uint32_t i = m_frameFirst; i < frameLast; ++i) {
+        if (m_codepoints[i] >= first && m_codepoints[i] <= last) {
+            viewport()->update();
+            return;
+        }
+    }
+}
+
+void TextPreview::onFontReset()
+{
+    m_glyphs.clear();
+    viewport()->update();
+}
+
+int TextPreview::columnsForWidth(int width) const
+{
+    return qMax(1, (width - 2 * MARGIN) / (UlfFont::GLYPH_W * m_scale));
+}
+
+int TextPreview::visibleRows() const
+{
+    int cellH = UlfFont::GLYPH_H * m_scale;
+    return qMax(1, (viewport()->height() - 2 * MARGIN + cellH - 1) / cellH);
+}
+
+void TextPreview::resizeEvent(QResizeEvent *event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+    if (columnsForWidth(viewport()->width()) == m_columns) {
+        updateScrollBar();
+        return;
+    }
+
+    // Keep the character at the top of the view in view across the rewrap
+    int row = verticalScrollBar()->value();
+    int paragraph = paragraphAtRow(row);
+    uint32_t anchor = (uint32_t)(row - m_rowStarts[paragraph]) * m_columns;
+
+    relayout();
+    verticalScrollBar()->setValue(m_rowStarts[paragraph] + (int)(anchor / m_columns));
+}
+
+void TextPreview::relayout()
+{
+    m_columns = columnsForWidth(viewport()->width());
+    int paragraphs = (int)m_paragraphStarts.size() - 1;
+    m_rowStarts.resize(paragraphs + 1);
+    int row = 0;
+    for (int p = 0; p < paragraphs; ++p) {
+        m_rowStarts[p] = row;
+        uint32_t length = m_paragraphStarts[p + 1] - m_paragraphStarts[p];
+        row += qMax(1, (int)((length + m_columns - 1) / m_columns));
+    }
+    m_rowStarts[paragraphs] = row;
+    updateScrollBar();
+}
+
+void TextPreview::updateScrollBar()
+{
+    // Only fully visible rows count for paging; a partial last row is drawn
+    int cellH = UlfFont::GLYPH_H * m_scale;
+    int fullRows = qMax(1, (viewport()->height() - 2 * MARGIN) / cellH);
+    verticalScrollBar()->setRange(0, qMax(0, m_rowStarts.back() - fullRows));
+    verticalScrollBar()->setPageStep(fullRows);
+    verticalScrollBar()->setSingleStep(1);
+}
+
+int TextPreview::paragraphAtRow(int row) const
+{
+    auto it = std::upper_bound(m_rowStarts.begin(), m_rowStarts.end() - 1, row);
+    return qMax(0, (int)(it - m_rowStarts.begin()) - 1);
+}
+
+const TextPreview::GlyphBitmap &TextPreview::glyphBitmap(const UnicodeMapEntry &entry)
+{
+    uint64_t baseGeneration = m_font->baseGeneration(entry.baseIndex);
+    uint64_t overlayGeneration = entry.overlayIndex < UlfFont::OVERLAY_COUNT
+        ? m_font->overlayGeneration(entry.overlayIndex) : 0;
+
+    GlyphBitmap &glyph = m_glyphs[UlfFont::compositeKey(entry)];
+    if (glyph.baseGeneration != baseGeneration || glyph.overlayGeneration != overlayGeneration) {
+        const uint32_t *rows = m_font->cachedComposite(entry);
+        for (int y = 0; y < UlfFont::GLYPH_H; ++y)
+            for (int x = 0; x < UlfFont::GLYPH_W; ++x)
+                glyph.pixels[y][x] = uchar(UlfFont::packedPixel(rows, x, y));
+        glyph.baseGeneration = baseGeneration;
+        glyph.overlayGeneration = overlayGeneration;
+    }
+    return glyph;
+}
+
+void TextPreview::paintEvent(QPaintEvent *)
+{
+    QPainter p(viewport());
+    p.setRenderHint(QPainter::Antialiasing, false);
+
+    QColor bg = m_colorSettings ? m_colorSettings->bgColor() : Qt::black;
+    p.fillRect(viewport()->rect(), bg);
+
+    m_usedBase.reset();
+    m_usedOverlay.reset();
+    m_frameFirst = m_frameLast = 0;
+    if (!m_font || !m_colorSettings)
+        return;
+
+    int rows = visibleRows();
+    QSize frameSize(m_columns * UlfFont::GLYPH_W, rows * UlfFont::GLYPH_H);
+    if (m_frame.size() != frameSize)
+        m_frame = QImage(frameSize, QImage::Format_Indexed8);
+    m_frame.fill(0);
+
+    int firstRow = verticalScrollBar()->value();
+    int paragraph = paragraphAtRow(firstRow);
+    int paragraphs = (int)m_paragraphStarts.size() - 1;
+    m_frameFirst = m_paragraphStarts[paragraph]
+        + (uint32_t)(firstRow - m_rowStarts[paragraph]) * m_columns;
+    m_frameLast = m_frameFirst;
+
+    for (int r = 0; r < rows && paragraph < paragraphs; ++r) {
+        int row = firstRow + r;
+        uint32_t start = m_paragraphStarts[paragraph] + (uint32_t)(row - m_rowStarts[paragraph]) * m_columns;
+        uint32_t end = qMin(start + (uint32_t)m_columns, m_paragraphStarts[paragraph + 1]);
+
+        for (uint32_t i = start; i < end; ++i) {
+            const UnicodeMapEntry *entry = m_font->findEntry(m_codepoints[i]);
+            if (!entry)
+                continue;
+            m_usedBase.set(entry->baseIndex);
+            if (entry->overlayIndex < UlfFont::OVERLAY_COUNT)
+                m_usedOverlay.set(entry->overlayIndex);
+
+            const GlyphBitmap &glyph = glyphBitmap(*entry);
+            int x = (int)(i - start) * UlfFont::GLYPH_W;
+            for (int gy = 0; gy < UlfFont::GLYPH_H; ++gy)
+                std::memcpy(m_frame.scanLine(r * UlfFont::GLYPH_H + gy) + x,
+                            glyph.pixels[gy], UlfFont::GLYPH_W);
+        }
+        m_frameLast = qMax(m_frameLast, end);
+
+        if (row + 1 >= m_rowStarts[paragraph + 1])
+            ++paragraph;
+    }
+
+    m_frame.setColorTable(m_colorSettings->colorTable());
+    p.drawImage(QRect(MARGIN, MARGIN, m_frame.width() * m_scale, m_frame.height() * m_scale), m_frame);
+}
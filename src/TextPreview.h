@@ -0,0 +1,74 @@
+#pragma once
+#include <QAbstractScrollArea>
+#include <QHash>
+#include <QImage>
+#include <bitset>
+#include <vector>
+#include "UlfFont.h"
+
+class ColorSettings;
+
+// Scrolling preview of a whole document in the current font. Lines wrap at
+// the character cell, as on the X16 screen, so the layout is a row count
+// per paragraph and only the visible rows are ever rendered.
+class TextPreview : public QAbstractScrollArea {
+    Q_OBJECT
+public:
+    explicit TextPreview(QWidget *parent = nullptr);
+
+    void setFont(UlfFont *font);
+    void setColorSettings(ColorSettings *cs);
+    void setText(const QString &text);
+    // Repaint after glyph or map edits; stale glyph bitmaps are detected
+    // through the font's slot generations
+    void refresh();
+
+    QSize sizeHint() const override;
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+
+private:
+    // Glyph cell at 1x, color indices as in UlfFont::packedPixel
+    struct GlyphBitmap {
+        uint64_t baseGeneration = ~uint64_t(0);  // not rendered yet
+        uint64_t overlayGeneration = 0;
+        uchar pixels[UlfFont::GLYPH_H][UlfFont::GLYPH_W];
+    };
+
+    void onBaseGlyphChanged(int glyphIndex);
+    void onOverlayGlyphChanged(int glyphIndex);
+    void onMapRangeChanged(uint32_t first, uint32_t last);
+    void onFontReset();
+
+    int columnsForWidth(int width) const;
+    int visibleRows() const;
+    void relayout();
+    void updateScrollBar();
+    int paragraphAtRow(int row) const;
+    const GlyphBitmap &glyphBitmap(const UnicodeMapEntry &entry);
+
+    UlfFont *m_font = nullptr;
+    ColorSettings *m_colorSettings = nullptr;
+    int m_scale = 2;
+
+    // Document as codepoints without line breaks; paragraph p is
+    // [m_paragraphStarts[p], m_paragraphStarts[p + 1])
+    std::vector<uint32_t> m_codepoints;
+    std::vector<uint32_t> m_paragraphStarts;
+
+    // Wrapped layout: first visual row of each paragraph, total at the end
+    int m_columns = 1;
+    std::vector<int> m_rowStarts;
+
+    QHash<uint32_t, GlyphBitmap> m_glyphs;  // by UlfFont::compositeKey
+
+    // Last frame: visible rows at 1x, the slice of m_codepoints it covers
+    // and the glyphs it used, so unrelated edits don't repaint
+    QImage m_frame;
+    uint32_t m_frameFirst = 0;
+    uint32_t m_frameLast = 0;
+    std::bitset<UlfFont::BASE_COUNT> m_usedBase;
+    std::bitset<UlfFont::OVERLAY_COUNT> m_usedOverlay;
+};
@@ -1,59 +1,219 @@
 #include "UlfFont.h"
-#include <QFile>
+#include "UlfFontView.h"
+#include "UlfFontSnapshot.h"
+#include "FontNotifier.h"
+#include <QSaveFile>
+#include <algorithm>
 #include <cstring>
+#include <iterator>
+#include <map>
 
-static constexpr int OVERLAY_OFFSET = 0x0000;
-static constexpr int BASE_OFFSET = 0x8000;
-static constexpr int MAP_OFFSET = 0x9000;
+namespace {
+
+// Lookup tables for the compositing kernel
+struct CompositeTables {
+    uint32_t baseNibbles[256];    // 8 x 1bpp -> 8 nibbles of 0/1
+    uint16_t overlayNibbles[256]; // 4 x 2bpp -> 4 nibbles of 0-3
+    uint8_t pairReverse[256];     // 4 x 2bpp mirrored within the byte
+
+    constexpr CompositeTables() : baseNibbles(), overlayNibbles(), pairReverse()
+    {
+        for (int v = 0; v < 256; ++v) {
+            for (int bit = 0; bit < 8; ++bit)
+                baseNibbles[v] |= (uint32_t)((v >> bit) & 1) << (bit * 4);
+            for (int pair = 0; pair < 4; ++pair) {
+                int px = (v >> (pair * 2)) & 3;
+                overlayNibbles[v] |= (uint16_t)(px << (pair * 4));
+                pairReverse[v] |= (uint8_t)(px << ((3 - pair) * 2));
+            }
+        }
+    }
+};
+
+constexpr CompositeTables kTables;
+
+} // namespace
+
+UlfFont::UlfFont()
+{
+    touchAllGlyphs();
+}
+
+UlfFont::UlfFont(const UlfFontView &view)
+{
+    loadFromView(view);
+}
 
 void UlfFont::clear()
 {
-    std::memset(baseGlyphs, 0, sizeof(baseGlyphs));
-    std::memset(overlayGlyphs, 0, sizeof(overlayGlyphs));
+    resetData();
+    if (m_notifier)
+        emit m_notifier->fontReset();
+}
+
+void UlfFont::resetData()
+{
+    baseGlyphs.clear();
+    overlayGlyphs.clear();
     unicodeMap.clear();
+    m_index = std::make_shared<SpanIndex>();
+    for (auto &users : m_baseUsers)
+        users.clear();
+    for (auto &users : m_overlayUsers)
+        users.clear();
+    touchAllGlyphs();
 }
 
-int UlfFont::basePixel(int glyphIndex, int x, int y) const
+void UlfFont::touchAllGlyphs()
 {
-    if (glyphIndex < 0 || glyphIndex >= BASE_COUNT || x < 0 || x >= GLYPH_W || y < 0 || y >= GLYPH_H)
-        return 0;
-    uint8_t row = baseGlyphs[glyphIndex][y];
-    return (row >> (7 - x)) & 1;
+    ++m_generation;
+    std::fill(std::begin(m_baseGenerations), std::end(m_baseGenerations), m_generation);
+    std::fill(std::begin(m_overlayGenerations), std::end(m_overlayGenerations), m_generation);
+    m_compositeCache.clear();
+
+    m_baseSlotsByHash.clear();
+    m_overlaySlotsByHash.clear();
+    for (int i = 0; i < BASE_COUNT; ++i) {
+        m_baseHashes[i] = hashGlyph(baseGlyphs[i], BASE_GLYPH_BYTES);
+        m_baseSlotsByHash[m_baseHashes[i]].push_back(i);
+    }
+    for (int i = 0; i < OVERLAY_COUNT; ++i) {
+        m_overlayHashes[i] = hashGlyph(overlayGlyphs[i], OVERLAY_GLYPH_BYTES);
+        m_overlaySlotsByHash[m_overlayHashes[i]].push_back(i);
+    }
 }
 
-void UlfFont::setBasePixel(int glyphIndex, int x, int y, int value)
+void UlfFont::touchBaseGlyph(int glyphIndex)
 {
-    if (glyphIndex < 0 || glyphIndex >= BASE_COUNT || x < 0 || x >= GLYPH_W || y < 0 || y >= GLYPH_H)
+    m_baseGenerations[glyphIndex] = ++m_generation;
+    rehashSlot(m_baseSlotsByHash, m_baseHashes[glyphIndex], glyphIndex,
+               hashGlyph(baseGlyphs[glyphIndex], BASE_GLYPH_BYTES));
+    if (m_notifier)
+        emit m_notifier->baseGlyphChanged(glyphIndex);
+}
+
+void UlfFont::touchOverlayGlyph(int glyphIndex)
+{
+    m_overlayGenerations[glyphIndex] = ++m_generation;
+    rehashSlot(m_overlaySlotsByHash, m_overlayHashes[glyphIndex], glyphIndex,
+               hashGlyph(overlayGlyphs[glyphIndex], OVERLAY_GLYPH_BYTES));
+    if (m_notifier)
+        emit m_notifier->overlayGlyphChanged(glyphIndex);
+}
+
+void UlfFont::rehashSlot(SlotsByHash &slotsByHash, uint64_t &slotHash, int glyphIndex, uint64_t newHash)
+{
+    if (newHash == slotHash)
         return;
-    uint8_t &row = baseGlyphs[glyphIndex][y];
-    uint8_t mask = 1 << (7 - x);
-    if (value)
-        row |= mask;
-    else
-        row &= ~mask;
+    auto it = slotsByHash.find(slotHash);
+    if (it != slotsByHash.end()) {
+        auto &slots = it->second;
+        slots.erase(std::lower_bound(slots.begin(), slots.end(), glyphIndex));
+        if (slots.empty())
+            slotsByHash.erase(it);
+    }
+    auto &slots = slotsByHash[newHash];
+    slots.insert(std::lower_bound(slots.begin(), slots.end(), glyphIndex), glyphIndex);
+    slotHash = newHash;
 }
 
-int UlfFont::overlayPixel(int glyphIndex, int x, int y) const
+uint64_t UlfFont::hashGlyph(const uint8_t *bytes, int size)
 {
-    if (glyphIndex < 0 || glyphIndex >= OVERLAY_COUNT || x < 0 || x >= GLYPH_W || y < 0 || y >= GLYPH_H)
+    // Whole 64-bit words through a murmur3-style finalizer; glyphs are always
+    // 16 or 32 bytes
+    uint64_t h = 0x9E3779B97F4A7C15ull ^ uint64_t(size);
+    for (int i = 0; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, 8);
+        h ^= word;
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ull;
+        h ^= h >> 33;
+    }
+    return h;
+}
+
+uint64_t UlfFont::baseHash(int glyphIndex) const
+{
+    if (glyphIndex < 0 || glyphIndex >= BASE_COUNT)
         return 0;
-    // Packed 2bpp: 4 pixels per byte, 2 bytes per row, MSB-first
-    int byteOffset = y * 2 + (x / 4);
-    int shift = 6 - (x % 4) * 2;
-    return (overlayGlyphs[glyphIndex][byteOffset] >> shift) & 3;
+    return m_baseHashes[glyphIndex];
 }
 
-void UlfFont::setOverlayPixel(int glyphIndex, int x, int y, int value)
+uint64_t UlfFont::overlayHash(int glyphIndex) const
 {
-    if (glyphIndex < 0 || glyphIndex >= OVERLAY_COUNT || x < 0 || x >= GLYPH_W || y < 0 || y >= GLYPH_H)
-        return;
+    if (glyphIndex < 0 || glyphIndex >= OVERLAY_COUNT)
+        return 0;
+    return m_overlayHashes[glyphIndex];
+}
+
+const std::vector<int> &UlfFont::baseSlotsWithHash(uint64_t hash) const
+{
+    static const std::vector<int> none;
+    auto it = m_baseSlotsByHash.find(hash);
+    return it == m_baseSlotsByHash.end() ? none : it->second;
+}
+
+const std::vector<int> &UlfFont::overlaySlotsWithHash(uint64_t hash) const
+{
+    static const std::vector<int> none;
+    auto it = m_overlaySlotsByHash.find(hash);
+    return it == m_overlaySlotsByHash.end() ? none : it->second;
+}
+
+int UlfFont::findBaseGlyph(const uint8_t *bytes) const
+{
+    for (int slot : baseSlotsWithHash(hashGlyph(bytes, BASE_GLYPH_BYTES))) {
+        if (std::memcmp(baseGlyphs[slot], bytes, BASE_GLYPH_BYTES) == 0)
+            return slot;
+    }
+    return -1;
+}
+
+int UlfFont::findOverlayGlyph(const uint8_t *bytes) const
+{
+    for (int slot : overlaySlotsWithHash(hashGlyph(bytes, OVERLAY_GLYPH_BYTES))) {
+        if (std::memcmp(overlayGlyphs[slot], bytes, OVERLAY_GLYPH_BYTES) == 0)
+            return slot;
+    }
+    return -1;
+}
+
+uint64_t UlfFont::baseGeneration(int glyphIndex) const
+{
+    if (glyphIndex < 0 || glyphIndex >= BASE_COUNT)
+        return 0;
+    return m_baseGenerations[glyphIndex];
+}
+
+uint64_t UlfFont::overlayGeneration(int glyphIndex) const
+{
+    if (glyphIndex < 0 || glyphIndex >= OVERLAY_COUNT)
+        return 0;
+    return m_overlayGenerations[glyphIndex];
+}
+
+int UlfFont::basePixel(const uint8_t *glyph, int x, int y)
+{
+    if (x < 0 || x >= GLYPH_W || y < 0 || y >= GLYPH_H)
+        return 0;
+    return (glyph[y] >> (7 - x)) & 1;
+}
+
+int UlfFont::overlayPixel(const uint8_t *glyph, int x, int y)
+{
+    if (x < 0 || x >= GLYPH_W || y < 0 || y >= GLYPH_H)
+        return 0;
+    // Packed 2bpp: 4 pixels per byte, 2 bytes per row, MSB-first
     int byteOffset = y * 2 + (x / 4);
     int shift = 6 - (x % 4) * 2;
-    uint8_t &b = overlayGlyphs[glyphIndex][byteOffset];
-    b = (b & ~(3 << shift)) | ((value & 3) << shift);
+    return (glyph[byteOffset] >> shift) & 3;
 }
 
-int UlfFont::compositedPixel(const UnicodeMapEntry &entry, int x, int y) const
+int UlfFont::compositedPixel(const uint8_t *base, const uint8_t *overlay,
+                             const UnicodeMapEntry &entry, int x, int y)
 {
     if (entry.noGlyph)
         return 0;
@@ -62,11 +222,11 @@ int UlfFont::compositedPixel(const UnicodeMapEntry &entry, int x, int y) const
     int ox = entry.hflip ? (GLYPH_W - 1 - x) : x;
     int oy = entry.vflip ? (GLYPH_H - 1 - y) : y;
 
-    int ovPixel = overlayPixel(entry.overlayIndex, ox, oy);
+    int ovPixel = overlay ? overlayPixel(overlay, ox, oy) : 0;
 
     if (ovPixel == 0) {
         // Transparent — show base layer
-        int bp = basePixel(entry.baseIndex, x, y);
+        int bp = basePixel(base, x, y);
         if (entry.reverse)
             bp = 1 - bp;
         return bp; // 0=bg, 1=fg
@@ -76,102 +236,478 @@ int UlfFont::compositedPixel(const UnicodeMapEntry &entry, int x, int y) const
     return ovPixel + 1; // 2=ov1, 3=ov2, 4=fg
 }
 
-bool UlfFont::loadFromFile(const QString &path)
+UnicodeMapEntry UlfFont::decodeEntry(const uint8_t *bytes)
 {
-    QFile file(path);
-    if (!file.open(QIODevice::ReadOnly))
-        return false;
+    UnicodeMapEntry entry;
+    entry.baseIndex = bytes[0];
+    uint8_t flags = bytes[2];
+    entry.overlayIndex = ((flags & 0x03) << 8) | bytes[1];
+    entry.reverse = (flags & 0x80) != 0;
+    entry.noGlyph = (flags & 0x40) != 0;
+    entry.vflip = (flags & 0x08) != 0;
+    entry.hflip = (flags & 0x04) != 0;
+    return entry;
+}
 
-    QByteArray data = file.readAll();
-    if (data.size() < MAP_OFFSET)
-        return false;
+void UlfFont::encodeEntry(const UnicodeMapEntry &entry, uint8_t *bytes)
+{
+    bytes[0] = entry.baseIndex;
+    bytes[1] = entry.overlayIndex & 0xFF;
+    uint8_t flags = (entry.overlayIndex >> 8) & 0x03;
+    if (entry.reverse) flags |= 0x80;
+    if (entry.noGlyph) flags |= 0x40;
+    if (entry.vflip) flags |= 0x08;
+    if (entry.hflip) flags |= 0x04;
+    bytes[2] = flags;
+}
+
+int UlfFont::basePixel(int glyphIndex, int x, int y) const
+{
+    if (glyphIndex < 0 || glyphIndex >= BASE_COUNT)
+        return 0;
+    return basePixel(baseGlyphs[glyphIndex], x, y);
+}
+
+void UlfFont::setBasePixel(int glyphIndex, int x, int y, int value)
+{
+    if (glyphIndex < 0 || glyphIndex >= BASE_COUNT || x < 0 || x >= GLYPH_W || y < 0 || y >= GLYPH_H)
+        return;
+    uint8_t row = baseGlyphs[glyphIndex][y];
+    uint8_t mask = 1 << (7 - x);
+    uint8_t newRow = value ? (row | mask) : (row & ~mask);
+    if (newRow != row) {
+        baseGlyphs.detach(glyphIndex)[y] = newRow;
+        touchBaseGlyph(glyphIndex);
+    }
+}
+
+int UlfFont::overlayPixel(int glyphIndex, int x, int y) const
+{
+    if (glyphIndex < 0 || glyphIndex >= OVERLAY_COUNT)
+        return 0;
+    return overlayPixel(overlayGlyphs[glyphIndex], x, y);
+}
+
+void UlfFont::setOverlayPixel(int glyphIndex, int x, int y, int value)
+{
+    if (glyphIndex < 0 || glyphIndex >= OVERLAY_COUNT || x < 0 || x >= GLYPH_W || y < 0 || y >= GLYPH_H)
+        return;
+    int byteOffset = y * 2 + (x / 4);
+    int shift = 6 - (x % 4) * 2;
+    uint8_t b = overlayGlyphs[glyphIndex][byteOffset];
+    uint8_t newByte = (b & ~(3 << shift)) | ((value & 3) << shift);
+    if (newByte != b) {
+        overlayGlyphs.detach(glyphIndex)[byteOffset] = newByte;
+        touchOverlayGlyph(glyphIndex);
+    }
+}
+
+void UlfFont::setBaseGlyph(int glyphIndex, const uint8_t *bytes)
+{
+    if (glyphIndex < 0 || glyphIndex >= BASE_COUNT)
+        return;
+    if (std::memcmp(baseGlyphs[glyphIndex], bytes, BASE_GLYPH_BYTES) != 0) {
+        std::memcpy(baseGlyphs.detach(glyphIndex), bytes, BASE_GLYPH_BYTES);
+        touchBaseGlyph(glyphIndex);
+    }
+}
+
+void UlfFont::setOverlayGlyph(int glyphIndex, const uint8_t *bytes)
+{
+    if (glyphIndex < 0 || glyphIndex >= OVERLAY_COUNT)
+        return;
+    if (std::memcmp(overlayGlyphs[glyphIndex], bytes, OVERLAY_GLYPH_BYTES) != 0) {
+        std::memcpy(overlayGlyphs.detach(glyphIndex), bytes, OVERLAY_GLYPH_BYTES);
+        touchOverlayGlyph(glyphIndex);
+    }
+}
+
+int UlfFont::compositedPixel(const UnicodeMapEntry &entry, int x, int y) const
+{
+    const uint8_t *overlay = entry.overlayIndex < OVERLAY_COUNT
+        ? overlayGlyphs[entry.overlayIndex] : nullptr;
+    return compositedPixel(baseGlyphs[entry.baseIndex], overlay, entry, x, y);
+}
+
+const UnicodeMapEntry *UlfFont::findEntry(uint32_t codepoint) const
+{
+    return findEntry(unicodeMap, *m_index, codepoint);
+}
+
+const UnicodeMapEntry *UlfFont::findEntry(const UnicodeMap &map, const SpanIndex &index,
+                                          uint32_t codepoint)
+{
+    auto it = std::upper_bound(index.begin(), index.end(), codepoint,
+        [](uint32_t cp, const IndexSpan &span) { return cp < span.start; });
+    if (it == index.begin())
+        return nullptr;
+    --it;
+    if (codepoint >= it->end)
+        return nullptr;
+    const auto &block = map[it->blockIndex];
+    return &block.entries[codepoint - block.startCodepoint];
+}
+
+void UlfFont::insertBlock(int blockIndex, const UnicodeMapBlock &block)
+{
+    auto &blocks = unicodeMap.detachList();
+    blocks.insert(blocks.begin() + blockIndex, std::make_shared<UnicodeMapBlock>(block));
+    ++m_generation;
+    rebuildSpans();
+    indexUsers(blockIndex, 0, (int)block.entries.size());
+    if (m_notifier) {
+        emit m_notifier->blockInserted(blockIndex);
+        notifyRange(block.startCodepoint, block.entries.size());
+    }
+}
+
+void UlfFont::removeBlock(int blockIndex)
+{
+    uint32_t start = unicodeMap[blockIndex].startCodepoint;
+    size_t count = unicodeMap[blockIndex].entries.size();
+    unindexUsers(blockIndex, 0, (int)count);
+    auto &blocks = unicodeMap.detachList();
+    blocks.erase(blocks.begin() + blockIndex);
+    ++m_generation;
+    rebuildSpans();
+    if (m_notifier) {
+        emit m_notifier->blockRemoved(blockIndex);
+        notifyRange(start, count);
+    }
+}
+
+void UlfFont::setBlockStart(int blockIndex, uint32_t startCodepoint)
+{
+    uint32_t oldStart = unicodeMap[blockIndex].startCodepoint;
+    size_t count = unicodeMap[blockIndex].entries.size();
+    unindexUsers(blockIndex, 0, (int)count);
+    unicodeMap.detachBlock(blockIndex).startCodepoint = startCodepoint;
+    ++m_generation;
+    rebuildSpans();
+    indexUsers(blockIndex, 0, (int)count);
+    if (m_notifier) {
+        emit m_notifier->blockStartChanged(blockIndex);
+        notifyRange(oldStart, count);
+        notifyRange(startCodepoint, count);
+    }
+}
+
+void UlfFont::insertEntry(int blockIndex, int entryIndex, const UnicodeMapEntry &entry)
+{
+    auto &entries = unicodeMap.detachBlock(blockIndex).entries;
+    // Later entries move up one codepoint
+    unindexUsers(blockIndex, entryIndex, (int)entries.size());
+    entries.insert(entries.begin() + entryIndex, entry);
+    ++m_generation;
+    rebuildSpans();
+    indexUsers(blockIndex, entryIndex, (int)entries.size());
+    if (m_notifier) {
+        emit m_notifier->entryInserted(blockIndex, entryIndex);
+        notifyRange(unicodeMap[blockIndex].startCodepoint + entryIndex, entries.size() - entryIndex);
+    }
+}
+
+void UlfFont::removeEntry(int blockIndex, int entryIndex)
+{
+    auto &entries = unicodeMap.detachBlock(blockIndex).entries;
+    unindexUsers(blockIndex, entryIndex, (int)entries.size());
+    entries.erase(entries.begin() + entryIndex);
+    ++m_generation;
+    rebuildSpans();
+    indexUsers(blockIndex, entryIndex, (int)entries.size());
+    if (m_notifier) {
+        emit m_notifier->entryRemoved(blockIndex, entryIndex);
+        notifyRange(unicodeMap[blockIndex].startCodepoint + entryIndex, entries.size() - entryIndex + 1);
+    }
+}
+
+void UlfFont::setEntry(int blockIndex, int entryIndex, const UnicodeMapEntry &entry)
+{
+    // Same codepoint span, so only the usage index changes
+    unindexUsers(blockIndex, entryIndex, entryIndex + 1);
+    unicodeMap.detachBlock(blockIndex).entries[entryIndex] = entry;
+    ++m_generation;
+    indexUsers(blockIndex, entryIndex, entryIndex + 1);
+    if (m_notifier) {
+        emit m_notifier->entryChanged(blockIndex, entryIndex);
+        notifyRange(unicodeMap[blockIndex].startCodepoint + entryIndex, 1);
+    }
+}
+
+void UlfFont::notifyRange(uint32_t start, size_t count)
+{
+    if (count > 0)
+        emit m_notifier->mapRangeChanged(start, start + uint32_t(count - 1));
+}
+
+const std::vector<uint32_t> &UlfFont::baseGlyphUsers(int glyphIndex) const
+{
+    static const std::vector<uint32_t> none;
+    if (glyphIndex < 0 || glyphIndex >= BASE_COUNT)
+        return none;
+    return m_baseUsers[glyphIndex];
+}
+
+const std::vector<uint32_t> &UlfFont::overlayGlyphUsers(int glyphIndex) const
+{
+    static const std::vector<uint32_t> none;
+    if (glyphIndex < 0 || glyphIndex >= OVERLAY_COUNT)
+        return none;
+    return m_overlayUsers[glyphIndex];
+}
+
+void UlfFont::indexUsers(int blockIndex, int firstEntry, int lastEntry)
+{
+    const auto &block = unicodeMap[blockIndex];
+    for (int ei = firstEntry; ei < lastEntry; ++ei) {
+        const auto &entry = block.entries[ei];
+        uint32_t cp = block.startCodepoint + ei;
+        auto &base = m_baseUsers[entry.baseIndex];
+        base.insert(std::upper_bound(base.begin(), base.end(), cp), cp);
+        if (entry.overlayIndex < OVERLAY_COUNT) {
+            auto &overlay = m_overlayUsers[entry.overlayIndex];
+            overlay.insert(std::upper_bound(overlay.begin(), overlay.end(), cp), cp);
+        }
+    }
+}
+
+void UlfFont::unindexUsers(int blockIndex, int firstEntry, int lastEntry)
+{
+    const auto &block = unicodeMap[blockIndex];
+    for (int ei = firstEntry; ei < lastEntry; ++ei) {
+        const auto &entry = block.entries[ei];
+        uint32_t cp = block.startCodepoint + ei;
+        auto &base = m_baseUsers[entry.baseIndex];
+        auto it = std::lower_bound(base.begin(), base.end(), cp);
+        if (it != base.end() && *it == cp)
+            base.erase(it);
+        if (entry.overlayIndex < OVERLAY_COUNT) {
+            auto &overlay = m_overlayUsers[entry.overlayIndex];
+            it = std::lower_bound(overlay.begin(), overlay.end(), cp);
+            if (it != overlay.end() && *it == cp)
+                overlay.erase(it);
+        }
+    }
+}
+
+void UlfFont::rebuildIndex()
+{
+    rebuildSpans();
+
+    for (auto &users : m_baseUsers)
+        users.clear();
+    for (auto &users : m_overlayUsers)
+        users.clear();
+    for (int bi = 0; bi < (int)unicodeMap.size(); ++bi) {
+        const auto &block = unicodeMap[bi];
+        for (int ei = 0; ei < (int)block.entries.size(); ++ei) {
+            const auto &entry = block.entries[ei];
+            m_baseUsers[entry.baseIndex].push_back(block.startCodepoint + ei);
+            if (entry.overlayIndex < OVERLAY_COUNT)
+                m_overlayUsers[entry.overlayIndex].push_back(block.startCodepoint + ei);
+        }
+    }
+    for (auto &users : m_baseUsers)
+        std::sort(users.begin(), users.end());
+    for (auto &users : m_overlayUsers)
+        std::sort(users.begin(), users.end());
+}
+
+void UlfFont::rebuildSpans()
+{
+    // O(b log b) in the number of blocks; entry counts don't matter.
+    // Spans are clipped against earlier blocks so that lookups give the same
+    // answer as a linear scan even when blocks overlap.
+    std::map<uint32_t, IndexSpan> covered;
+    for (int bi = 0; bi < (int)unicodeMap.size(); ++bi) {
+        const auto &block = unicodeMap[bi];
+        uint32_t start = block.startCodepoint;
+        uint32_t end = start + (uint32_t)block.entries.size();
+
+        auto it = covered.upper_bound(start);
+        if (it != covered.begin() && std::prev(it)->second.end > start)
+            start = std::prev(it)->second.end;
+
+        while (start < end) {
+            it = covered.lower_bound(start);
+            uint32_t gapEnd = (it == covered.end()) ? end : std::min(end, it->first);
+            if (gapEnd > start)
+                covered[start] = {start, gapEnd, bi};
+            if (it == covered.end())
+                break;
+            start = std::max(start, it->second.end);
+        }
+    }
+
+    auto index = std::make_shared<SpanIndex>();
+    index->reserve(covered.size());
+    for (const auto &kv : covered)
+        index->push_back(kv.second);
+    m_index = std::move(index);
+}
+
+void UlfFont::compositeGlyph(const uint8_t *base, const uint8_t *overlay,
+                             const UnicodeMapEntry &entry, uint32_t rows[GLYPH_H])
+{
+    if (entry.noGlyph) {
+        std::memset(rows, 0, GLYPH_H * sizeof(uint32_t));
+        return;
+    }
 
-    clear();
-
-    // Read overlay glyphs (0x0000 - 0x7FFF)
-    std::memcpy(overlayGlyphs, data.constData() + OVERLAY_OFFSET,
-                qMin((qint64)sizeof(overlayGlyphs), (qint64)(BASE_OFFSET - OVERLAY_OFFSET)));
-
-    // Read base glyphs (0x8000 - 0x8FFF)
-    std::memcpy(baseGlyphs, data.constData() + BASE_OFFSET,
-                qMin((qint64)sizeof(baseGlyphs), (qint64)(MAP_OFFSET - BASE_OFFSET)));
-
-    // Read unicode map blocks (0x9000+)
-    int pos = MAP_OFFSET;
-    while (pos + 4 <= data.size()) {
-        auto d = reinterpret_cast<const uint8_t *>(data.constData());
-        uint8_t lo = d[pos];
-        uint8_t mid = d[pos + 1];
-        uint8_t hi = d[pos + 2];
-        uint8_t count = d[pos + 3];
-        pos += 4;
-
-        if (count == 0)
-            break;
-
-        UnicodeMapBlock block;
-        block.startCodepoint = lo | (mid << 8) | (hi << 16);
-
-        for (int i = 0; i < count && pos + 3 <= data.size(); ++i) {
-            UnicodeMapEntry entry;
-            entry.baseIndex = d[pos];
-            uint8_t overlayLow = d[pos + 1];
-            uint8_t flags = d[pos + 2];
-
-            entry.overlayIndex = ((flags & 0x03) << 8) | overlayLow;
-            entry.reverse = (flags & 0x80) != 0;
-            entry.noGlyph = (flags & 0x40) != 0;
-            entry.vflip = (flags & 0x08) != 0;
-            entry.hflip = (flags & 0x04) != 0;
-
-            block.entries.push_back(entry);
-            pos += 3;
+    for (int y = 0; y < GLYPH_H; ++y) {
+        uint8_t b = entry.reverse ? (uint8_t)~base[y] : base[y];
+
+        int oy = entry.vflip ? (GLYPH_H - 1 - y) : y;
+        uint8_t o0 = overlay[oy * 2];
+        uint8_t o1 = overlay[oy * 2 + 1];
+        if (entry.hflip) {
+            uint8_t t = kTables.pairReverse[o0];
+            o0 = kTables.pairReverse[o1];
+            o1 = t;
         }
 
-        unicodeMap.push_back(block);
+        // Overlay pixels become 2-4, transparent ones fall through to the base
+        uint32_t ov = ((uint32_t)kTables.overlayNibbles[o0] << 16) | kTables.overlayNibbles[o1];
+        uint32_t opaque = (ov | (ov >> 1)) & 0x11111111u;
+        uint32_t mask = opaque * 0xF;
+        rows[y] = ((ov + opaque) & mask) | (kTables.baseNibbles[b] & ~mask);
     }
+}
+
+void UlfFont::compositeGlyph(const UnicodeMapEntry &entry, uint32_t rows[GLYPH_H]) const
+{
+    static const uint8_t emptyOverlay[OVERLAY_GLYPH_BYTES] = {};
+    const uint8_t *overlay = entry.overlayIndex < OVERLAY_COUNT
+        ? overlayGlyphs[entry.overlayIndex] : emptyOverlay;
+    compositeGlyph(baseGlyphs[entry.baseIndex], overlay, entry, rows);
 
+#ifndef QT_NO_DEBUG
+    // Debug builds cross-check the kernel against the per-pixel reference
+    for (int y = 0; y < GLYPH_H; ++y)
+        for (int x = 0; x < GLYPH_W; ++x)
+            Q_ASSERT(packedPixel(rows, x, y) == compositedPixel(entry, x, y));
+#endif
+}
+
+uint32_t UlfFont::compositeKey(const UnicodeMapEntry &entry)
+{
+    return entry.baseIndex
+        | (uint32_t)entry.overlayIndex << 8
+        | (uint32_t)entry.reverse << 24
+        | (uint32_t)entry.noGlyph << 25
+        | (uint32_t)entry.vflip << 26
+        | (uint32_t)entry.hflip << 27;
+}
+
+const uint32_t *UlfFont::cachedComposite(const UnicodeMapEntry &entry) const
+{
+    uint64_t baseGen = m_baseGenerations[entry.baseIndex];
+    uint64_t overlayGen = overlayGeneration(entry.overlayIndex);
+
+    auto [it, inserted] = m_compositeCache.try_emplace(compositeKey(entry));
+    CachedComposite &cached = it->second;
+    if (inserted || cached.baseGeneration != baseGen || cached.overlayGeneration != overlayGen) {
+        compositeGlyph(entry, cached.rows);
+        cached.baseGeneration = baseGen;
+        cached.overlayGeneration = overlayGen;
+    }
+    return cached.rows;
+}
+
+bool UlfFont::loadFromView(const UlfFontView &view)
+{
+    if (!view.isOpen())
+        return false;
+
+    resetData();
+
+    for (int i = 0; i < OVERLAY_COUNT; ++i)
+        std::memcpy(overlayGlyphs.detach(i), view.overlayGlyph(i), OVERLAY_GLYPH_BYTES);
+    for (int i = 0; i < BASE_COUNT; ++i)
+        std::memcpy(baseGlyphs.detach(i), view.baseGlyph(i), BASE_GLYPH_BYTES);
+    touchAllGlyphs();
+
+    auto &blocks = unicodeMap.detachList();
+    blocks.reserve(view.blocks().size());
+    for (const auto &viewBlock : view.blocks()) {
+        auto block = std::make_shared<UnicodeMapBlock>();
+        block->startCodepoint = viewBlock.startCodepoint;
+        block->entries.resize(viewBlock.entryCount);
+        for (int i = 0; i < viewBlock.entryCount; ++i)
+            block->entries[i] = decodeEntry(viewBlock.entries + i * MAP_ENTRY_BYTES);
+        blocks.push_back(std::move(block));
+    }
+
+    rebuildIndex();
+    if (m_notifier)
+        emit m_notifier->fontReset();
     return true;
 }
 
+void UlfFont::adopt(UlfFont &other)
+{
+    baseGlyphs = other.baseGlyphs;
+    overlayGlyphs = other.overlayGlyphs;
+    unicodeMap = other.unicodeMap;
+    m_index = other.m_index;
+    for (int i = 0; i < BASE_COUNT; ++i)
+        m_baseUsers[i].swap(other.m_baseUsers[i]);
+    for (int i = 0; i < OVERLAY_COUNT; ++i)
+        m_overlayUsers[i].swap(other.m_overlayUsers[i]);
+    std::copy(std::begin(other.m_baseHashes), std::end(other.m_baseHashes), m_baseHashes);
+    std::copy(std::begin(other.m_overlayHashes), std::end(other.m_overlayHashes), m_overlayHashes);
+    m_baseSlotsByHash.swap(other.m_baseSlotsByHash);
+    m_overlaySlotsByHash.swap(other.m_overlaySlotsByHash);
+
+    // Generations carry on from ours, so caches keyed on them see every
+    // slot as changed
+    ++m_generation;
+    std::fill(std::begin(m_baseGenerations), std::end(m_baseGenerations), m_generation);
+    std::fill(std::begin(m_overlayGenerations), std::end(m_overlayGenerations), m_generation);
+    m_compositeCache.clear();
+
+    // Drops other's references, so our pages and blocks are unshared again
+    other.resetData();
+    if (m_notifier)
+        emit m_notifier->fontReset();
+}
+
+bool UlfFont::loadFromFile(const QString &path)
+{
+    UlfFontView view;
+    if (!view.open(path))
+        return false;
+    return loadFromView(view);
+}
+
+UlfFontSnapshot UlfFont::snapshot() const
+{
+    return UlfFontSnapshot(m_generation, baseGlyphs, overlayGlyphs, unicodeMap, m_index);
+}
+
+QByteArray UlfFont::serialize() const
+{
+    return snapshot().serialize();
+}
+
 bool UlfFont::saveToFile(const QString &path) const
 {
-    QFile file(path);
+    return writeFile(path, serialize());
+}
+
+bool UlfFont::writeFile(const QString &path, const QByteArray &data)
+{
+    // QSaveFile writes to a temporary file next to the target and renames
+    // it over the target on commit (after syncing it to disk), so readers
+    // never see a partial font.
+    QSaveFile file(path);
     if (!file.open(QIODevice::WriteOnly))
         return false;
 
-    // Write overlay glyphs at offset 0x0000
-    file.write(reinterpret_cast<const char *>(overlayGlyphs), sizeof(overlayGlyphs));
-
-    // Write base glyphs at offset 0x8000
-    file.write(reinterpret_cast<const char *>(baseGlyphs), sizeof(baseGlyphs));
-
-    // Write unicode map blocks at offset 0x9000
-    for (const auto &block : unicodeMap) {
-        uint8_t header[4];
-        header[0] = block.startCodepoint & 0xFF;
-        header[1] = (block.startCodepoint >> 8) & 0xFF;
-        header[2] = (block.startCodepoint >> 16) & 0xFF;
-        header[3] = static_cast<uint8_t>(block.entries.size());
-        file.write(reinterpret_cast<const char *>(header), 4);
-
-        for (const auto &entry : block.entries) {
-            uint8_t bytes[3];
-            bytes[0] = entry.baseIndex;
-            bytes[1] = entry.overlayIndex & 0xFF;
-            uint8_t flags = (entry.overlayIndex >> 8) & 0x03;
-            if (entry.reverse) flags |= 0x80;
-            if (entry.noGlyph) flags |= 0x40;
-            if (entry.vflip) flags |= 0x08;
-            if (entry.hflip) flags |= 0x04;
-            bytes[2] = flags;
-            file.write(reinterpret_cast<const char *>(bytes), 3);
-        }
+    if (file.write(data) != data.size()) {
+        file.cancelWriting();
+        return false;
     }
 
-    // Write terminator block (count=0)
-    uint8_t terminator[4] = {0, 0, 0, 0};
-    file.write(reinterpret_cast<const char *>(terminator), 4);
-
-    return true;
+    return file.commit();
 }
@@ -1,6 +1,12 @@
 #pragma once
+#include <array>
+#include <atomic>
 #include <cstdint>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
 #include <vector>
+#include <QByteArray>
 #include <QString>
 
 struct UnicodeMapEntry {
@@ -12,11 +18,122 @@ struct UnicodeMapEntry {
     bool hflip = false;
 };
 
+class UlfFontView;
+class UlfFontSnapshot;
+class FontNotifier;
+
 struct UnicodeMapBlock {
     uint32_t startCodepoint = 0;  // 24-bit
     std::vector<UnicodeMapEntry> entries;
 };
 
+// Whether the font holds the only reference to shared data it's about to
+// write. Only the font's own thread takes new references (snapshots), so
+// the count can only drop behind our back, when a snapshot is released on
+// another thread. use_count() is a relaxed read; the acquire fence pairs it
+// with that release (an acq_rel decrement), so the snapshot's last reads
+// happen before our writes.
+template <typename T>
+inline bool isSoleOwner(const std::shared_ptr<T> &data)
+{
+    if (data.use_count() > 1)
+        return false;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return true;
+}
+
+// Fixed-size glyph table kept as shared pages of PAGE_GLYPHS glyphs.
+// Copies share pages; UlfFont copies a page before its first write while a
+// snapshot still holds it. Read-only outside UlfFont.
+template <int Count, int Bytes>
+class GlyphTable {
+public:
+    static constexpr int PAGE_GLYPHS = 16;
+    static constexpr int PAGE_COUNT = Count / PAGE_GLYPHS;
+
+    GlyphTable() { clear(); }
+
+    const uint8_t *operator[](int glyphIndex) const
+    {
+        return m_pages[glyphIndex / PAGE_GLYPHS]->glyphs[glyphIndex % PAGE_GLYPHS];
+    }
+
+private:
+    friend class UlfFont;
+
+    struct Page {
+        uint8_t glyphs[PAGE_GLYPHS][Bytes] = {};
+    };
+
+    void clear()
+    {
+        for (auto &page : m_pages)
+            page = std::make_shared<Page>();
+    }
+
+    // Only the owning font writes, and only from its own thread, so sole
+    // ownership means no snapshot can be reading the page
+    uint8_t *detach(int glyphIndex)
+    {
+        auto &page = m_pages[glyphIndex / PAGE_GLYPHS];
+        if (!isSoleOwner(page))
+            page = std::make_shared<Page>(*page);
+        return page->glyphs[glyphIndex % PAGE_GLYPHS];
+    }
+
+    std::array<std::shared_ptr<Page>, PAGE_COUNT> m_pages;
+};
+
+// Block list with the same two-level sharing: the list itself and each
+// block are copied on first write while shared. Read-only outside UlfFont.
+class UnicodeMap {
+    using BlockList = std::vector<std::shared_ptr<UnicodeMapBlock>>;
+
+public:
+    class const_iterator {
+    public:
+        explicit const_iterator(BlockList::const_iterator it) : m_it(it) {}
+        const UnicodeMapBlock &operator*() const { return **m_it; }
+        const UnicodeMapBlock *operator->() const { return m_it->get(); }
+        const_iterator &operator++() { ++m_it; return *this; }
+        bool operator==(const const_iterator &other) const { return m_it == other.m_it; }
+        bool operator!=(const const_iterator &other) const { return m_it != other.m_it; }
+
+    private:
+        BlockList::const_iterator m_it;
+    };
+
+    UnicodeMap() : m_blocks(std::make_shared<BlockList>()) {}
+
+    size_t size() const { return m_blocks->size(); }
+    bool empty() const { return m_blocks->empty(); }
+    const UnicodeMapBlock &operator[](size_t blockIndex) const { return *(*m_blocks)[blockIndex]; }
+    const_iterator begin() const { return const_iterator(m_blocks->cbegin()); }
+    const_iterator end() const { return const_iterator(m_blocks->cend()); }
+
+private:
+    friend class UlfFont;
+
+    void clear() { m_blocks = std::make_shared<BlockList>(); }
+
+    BlockList &detachList()
+    {
+        if (!isSoleOwner(m_blocks))
+            m_blocks = std::make_shared<BlockList>(*m_blocks);
+        return *m_blocks;
+    }
+
+    UnicodeMapBlock &detachBlock(size_t blockIndex)
+    {
+        auto &block = detachList()[blockIndex];
+        if (!isSoleOwner(block))
+            block = std::make_shared<UnicodeMapBlock>(*block);
+        return *block;
+    }
+
+    std::shared_ptr<BlockList> m_blocks;
+};
+
 class UlfFont {
 public:
     static constexpr int BASE_COUNT = 256;
@@ -26,12 +143,50 @@ public:
     static constexpr int BASE_GLYPH_BYTES = 16;
     static constexpr int OVERLAY_GLYPH_BYTES = 32;
 
-    uint8_t baseGlyphs[BASE_COUNT][BASE_GLYPH_BYTES]{};
-    uint8_t overlayGlyphs[OVERLAY_COUNT][OVERLAY_GLYPH_BYTES]{};
-    std::vector<UnicodeMapBlock> unicodeMap;
+    // File layout
+    static constexpr int OVERLAY_OFFSET = 0x0000;
+    static constexpr int BASE_OFFSET = 0x8000;
+    static constexpr int MAP_OFFSET = 0x9000;
+    static constexpr int BLOCK_HEADER_BYTES = 4;
+    static constexpr int MAP_ENTRY_BYTES = 3;
+    static constexpr int MAX_BLOCK_ENTRIES = 255;
+
+    using BaseTable = GlyphTable<BASE_COUNT, BASE_GLYPH_BYTES>;
+    using OverlayTable = GlyphTable<OVERLAY_COUNT, OVERLAY_GLYPH_BYTES>;
+
+    UlfFont();
+    explicit UlfFont(const UlfFontView &view);
+    // Not copyable (the notifier and caches belong to one font); use snapshot()
+    UlfFont(const UlfFont &) = delete;
+    UlfFont &operator=(const UlfFont &) = delete;
+
+    // Read-only; edit through the mutators below
+    BaseTable baseGlyphs;
+    OverlayTable overlayGlyphs;
+    UnicodeMap unicodeMap;
 
     void clear();
 
+    // Bumped by every change to glyphs or map
+    uint64_t version() const { return m_generation; }
+
+    // Immutable copy of the current glyphs and map for readers on other
+    // threads. O(1): pages and blocks are shared until the font next
+    // writes to them, and only those are copied.
+    UlfFontSnapshot snapshot() const;
+
+    // Optional observer; every mutator below reports through it
+    void setNotifier(FontNotifier *notifier) { m_notifier = notifier; }
+    FontNotifier *notifier() const { return m_notifier; }
+
+    // Pixel and entry decoding on raw glyph / map bytes, shared with UlfFontView
+    static int basePixel(const uint8_t *glyph, int x, int y);
+    static int overlayPixel(const uint8_t *glyph, int x, int y);
+    static int compositedPixel(const uint8_t *base, const uint8_t *overlay,
+                               const UnicodeMapEntry &entry, int x, int y);
+    static UnicodeMapEntry decodeEntry(const uint8_t *bytes);
+    static void encodeEntry(const UnicodeMapEntry &entry, uint8_t *bytes);
+
     // 1bpp base pixel access (0 or 1)
     int basePixel(int glyphIndex, int x, int y) const;
     void setBasePixel(int glyphIndex, int x, int y, int value);
@@ -40,10 +195,126 @@ public:
     int overlayPixel(int glyphIndex, int x, int y) const;
     void setOverlayPixel(int glyphIndex, int x, int y, int value);
 
+    // Whole-glyph writes (BASE_GLYPH_BYTES / OVERLAY_GLYPH_BYTES bytes)
+    void setBaseGlyph(int glyphIndex, const uint8_t *bytes);
+    void setOverlayGlyph(int glyphIndex, const uint8_t *bytes);
+
     // Composited pixel for a map entry (returns 0-3 overlay color, or -1/-2 for base bg/fg)
     // Returns a color index: 0=bg, 1=fg, 2=overlay color 1, 3=overlay color 2, 4=overlay fg
+    // This is the per-pixel reference for compositeGlyph.
     int compositedPixel(const UnicodeMapEntry &entry, int x, int y) const;
 
+    // Composite a whole glyph in one pass. Each output row packs the 8 color
+    // indices of that row (same values as compositedPixel) as 4-bit nibbles,
+    // pixel 0 in the top nibble. The static form works on raw glyph bytes
+    // (16 base bytes, 32 overlay bytes).
+    static void compositeGlyph(const uint8_t *base, const uint8_t *overlay,
+                               const UnicodeMapEntry &entry, uint32_t rows[GLYPH_H]);
+    void compositeGlyph(const UnicodeMapEntry &entry, uint32_t rows[GLYPH_H]) const;
+    static int packedPixel(const uint32_t *rows, int x, int y)
+    {
+        return (rows[y] >> (28 - x * 4)) & 0xF;
+    }
+
+    // Memoized compositeGlyph keyed by the entry's indices and flags. Cached
+    // rows are checked against the slot generations below, so a pixel edit
+    // only invalidates composites built from the glyph it touched. The
+    // returned rows stay valid until the font is cleared or reloaded.
+    const uint32_t *cachedComposite(const UnicodeMapEntry &entry) const;
+    // Identifies a composite: the entry's glyph indices and flags
+    static uint32_t compositeKey(const UnicodeMapEntry &entry);
+
+    // Per-slot generation numbers, bumped whenever a glyph's bytes change
+    uint64_t baseGeneration(int glyphIndex) const;
+    uint64_t overlayGeneration(int glyphIndex) const;
+
+    // Per-slot 64-bit content hashes, kept current with the glyph bytes.
+    // Equal glyphs have equal hashes; the reverse only holds after a memcmp.
+    static uint64_t hashGlyph(const uint8_t *bytes, int size);
+    uint64_t baseHash(int glyphIndex) const;
+    uint64_t overlayHash(int glyphIndex) const;
+    // Slots (ascending) whose content hashes to the given value
+    const std::vector<int> &baseSlotsWithHash(uint64_t hash) const;
+    const std::vector<int> &overlaySlotsWithHash(uint64_t hash) const;
+    // Lowest slot holding exactly these bytes, or -1
+    int findBaseGlyph(const uint8_t *bytes) const;
+    int findOverlayGlyph(const uint8_t *bytes) const;
+
+    // Codepoint lookup through the block index (O(log blocks)).
+    // Overlapping blocks resolve the same way as a front-to-back scan of
+    // unicodeMap: the earliest block covering the codepoint wins.
+    const UnicodeMapEntry *findEntry(uint32_t codepoint) const;
+
+    // Codepoints whose map entry refers to a glyph slot, ascending (a
+    // codepoint appears twice if overlapping blocks both map it). Kept up to
+    // date by the mutators below, so a lookup is O(1) and reading it O(result).
+    const std::vector<uint32_t> &baseGlyphUsers(int glyphIndex) const;
+    const std::vector<uint32_t> &overlayGlyphUsers(int glyphIndex) const;
+
+    // Map mutators — keep the codepoint and usage indexes in sync with unicodeMap
+    void insertBlock(int blockIndex, const UnicodeMapBlock &block);
+    void removeBlock(int blockIndex);
+    void setBlockStart(int blockIndex, uint32_t startCodepoint);
+    void insertEntry(int blockIndex, int entryIndex, const UnicodeMapEntry &entry);
+    void removeEntry(int blockIndex, int entryIndex);
+    void setEntry(int blockIndex, int entryIndex, const UnicodeMapEntry &entry);
+
+    bool loadFromView(const UlfFontView &view);
+    // Take over a font loaded elsewhere (e.g. on a worker thread) with its
+    // indexes already built, leaving other empty. Reported as a reset.
+    void adopt(UlfFont &other);
     bool loadFromFile(const QString &path);
+    // Complete file image, ready to write in one go
+    QByteArray serialize() const;
+    // Atomic: the target is replaced only once the whole image is on disk
     bool saveToFile(const QString &path) const;
+    static bool writeFile(const QString &path, const QByteArray &data);
+
+private:
+    friend class UlfFontSnapshot;
+
+    // Disjoint codepoint span [start, end) served by one block, sorted by
+    // start. Replaced, never edited, so snapshots can share it.
+    struct IndexSpan {
+        uint32_t start;
+        uint32_t end;
+        int blockIndex;
+    };
+    using SpanIndex = std::vector<IndexSpan>;
+    std::shared_ptr<const SpanIndex> m_index = std::make_shared<const SpanIndex>();
+    void rebuildSpans();
+    // Rebuild the codepoint and usage indexes from scratch (not reported)
+    void rebuildIndex();
+    static const UnicodeMapEntry *findEntry(const UnicodeMap &map, const SpanIndex &index,
+                                            uint32_t codepoint);
+
+    // Reverse index: glyph slot -> sorted codepoints of the entries using it
+    std::vector<uint32_t> m_baseUsers[BASE_COUNT];
+    std::vector<uint32_t> m_overlayUsers[OVERLAY_COUNT];
+    void indexUsers(int blockIndex, int firstEntry, int lastEntry);
+    void unindexUsers(int blockIndex, int firstEntry, int lastEntry);
+
+    struct CachedComposite {
+        uint64_t baseGeneration;
+        uint64_t overlayGeneration;
+        uint32_t rows[GLYPH_H];
+    };
+    void resetData();
+    void touchAllGlyphs();
+    void touchBaseGlyph(int glyphIndex);
+    void touchOverlayGlyph(int glyphIndex);
+    using SlotsByHash = std::unordered_map<uint64_t, std::vector<int>>;
+    static void rehashSlot(SlotsByHash &slotsByHash, uint64_t &slotHash, int glyphIndex, uint64_t newHash);
+    void notifyRange(uint32_t start, size_t count);
+
+    FontNotifier *m_notifier = nullptr;
+
+    uint64_t m_generation = 0;
+    uint64_t m_baseGenerations[BASE_COUNT]{};
+    uint64_t m_overlayGenerations[OVERLAY_COUNT]{};
+    uint64_t m_baseHashes[BASE_COUNT]{};
+    uint64_t m_overlayHashes[OVERLAY_COUNT]{};
+    SlotsByHash m_baseSlotsByHash;
+    SlotsByHash m_overlaySlotsByHash;
+    mutable std::unordered_map<uint32_t, CachedComposite> m_compositeCache;
 };
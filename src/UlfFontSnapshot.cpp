@@ -0,0 +1,81 @@
+#include "UlfFontSnapshot.h"
+
+const UnicodeMapEntry *UlfFontSnapshot::findEntry(uint32_t codepoint) const
+{
+    return UlfFont::findEntry(m_unicodeMap, *m_index, codepoint);
+}
+
+int UlfFontSnapshot::basePixel(int glyphIndex, int x, int y) const
+{
+    if (glyphIndex < 0 || glyphIndex >= UlfFont::BASE_COUNT)
+        return 0;
+    return UlfFont::basePixel(m_baseGlyphs[glyphIndex], x, y);
+}
+
+int UlfFontSnapshot::overlayPixel(int glyphIndex, int x, int y) const
+{
+    if (glyphIndex < 0 || glyphIndex >= UlfFont::OVERLAY_COUNT)
+        return 0;
+    return UlfFont::overlayPixel(m_overlayGlyphs[glyphIndex], x, y);
+}
+
+int UlfFontSnapshot::compositedPixel(const UnicodeMapEntry &entry, int x, int y) const
+{
+    const uint8_t *overlay = entry.overlayIndex < UlfFont::OVERLAY_COUNT
+        ? m_overlayGlyphs[entry.overlayIndex] : nullptr;
+    return UlfFont::compositedPixel(m_baseGlyphs[entry.baseIndex], overlay, entry, x, y);
+}
+
+void UlfFontSnapshot::compositeGlyph(const UnicodeMapEntry &entry, uint32_t rows[UlfFont::GLYPH_H]) const
+{
+    static const uint8_t emptyOverlay[UlfFont::OVERLAY_GLYPH_BYTES] = {};
+    const uint8_t *overlay = entry.overlayIndex < UlfFont::OVERLAY_COUNT
+        ? m_overlayGlyphs[entry.overlayIndex] : emptyOverlay;
+    UlfFont::compositeGlyph(m_baseGlyphs[entry.baseIndex], overlay, entry, rows);
+}
+
+QByteArray UlfFontSnapshot::serialize() const
+{
+    // Blocks longer than a one-byte count are split into consecutive
+    // blocks; empty blocks are dropped since a zero count ends the map.
+    qint64 size = UlfFont::MAP_OFFSET + UlfFont::BLOCK_HEADER_BYTES;
+    for (const auto &block : m_unicodeMap) {
+        qint64 count = (qint64)block.entries.size();
+        size += ((count + UlfFont::MAX_BLOCK_ENTRIES - 1) / UlfFont::MAX_BLOCK_ENTRIES)
+                    * UlfFont::BLOCK_HEADER_BYTES
+              + count * UlfFont::MAP_ENTRY_BYTES;
+    }
+
+    QByteArray data(size, 0);
+    auto d = reinterpret_cast<uint8_t *>(data.data());
+
+    for (int i = 0; i < UlfFont::OVERLAY_COUNT; ++i)
+        std::memcpy(d + UlfFont::OVERLAY_OFFSET + i * UlfFont::OVERLAY_GLYPH_BYTES,
+                    m_overlayGlyphs[i], UlfFont::OVERLAY_GLYPH_BYTES);
+    for (int i = 0; i < UlfFont::BASE_COUNT; ++i)
+        std::memcpy(d + UlfFont::BASE_OFFSET + i * UlfFont::BASE_GLYPH_BYTES,
+                    m_baseGlyphs[i], UlfFont::BASE_GLYPH_BYTES);
+
+    qint64 pos = UlfFont::MAP_OFFSET;
+    for (const auto &block : m_unicodeMap) {
+        int total = (int)block.entries.size();
+        for (int first = 0; first < total; first += UlfFont::MAX_BLOCK_ENTRIES) {
+            int count = qMin(total - first, UlfFont::MAX_BLOCK_ENTRIES);
+            uint32_t start = block.startCodepoint + first;
+            d[pos] = start & 0xFF;
+            d[pos + 1] = (start >> 8) & 0xFF;
+            d[pos + 2] = (start >> 16) & 0xFF;
+            d[pos + 3] = static_cast<uint8_t>(count);
+            pos += UlfFont::BLOCK_HEADER_BYTES;
+
+            for (int i = 0; i < count; ++i) {
+                UlfFont::encodeEntry(block.entries[first + i], d + pos);
+                pos += UlfFont::MAP_ENTRY_BYTES;
+            }
+        }
+    }
+
+    // Terminator block (count=0) is already zeroed
+    Q_ASSERT(pos + UlfFont::BLOCK_HEADER_BYTES == size);
+    return data;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <QByteArray>
+#include "UlfFont.h"
+
+// Frozen copy of a font's glyphs and map, taken with UlfFont::snapshot().
+// Shares pages and blocks with the font rather than copying them, and never
+// changes afterwards, so it can be handed to another thread (saving,
+// previews) while editing carries on. Same answers as the UlfFont accessors
+// of the same name, without the composite cache.
+class UlfFontSnapshot {
+public:
+    UlfFontSnapshot() : m_index(std::make_shared<const UlfFont::SpanIndex>()) {}
+
+    // UlfFont::version() at the time the snapshot was taken
+    uint64_t version() const { return m_version; }
+
+    const uint8_t *baseGlyph(int glyphIndex) const { return m_baseGlyphs[glyphIndex]; }
+    const uint8_t *overlayGlyph(int glyphIndex) const { return m_overlayGlyphs[glyphIndex]; }
+    const UnicodeMap &unicodeMap() const { return m_unicodeMap; }
+    const UnicodeMapEntry *findEntry(uint32_t codepoint) const;
+
+    int basePixel(int glyphIndex, int x, int y) const;
+    int overlayPixel(int glyphIndex, int x, int y) const;
+    int compositedPixel(const UnicodeMapEntry &entry, int x, int y) const;
+    void compositeGlyph(const UnicodeMapEntry &entry, uint32_t rows[UlfFont::GLYPH_H]) const;
+
+    // Complete file image, as UlfFont::serialize()
+    QByteArray serialize() const;
+
+private:
+    friend class UlfFont;
+    UlfFontSnapshot(uint64_t version, const UlfFont::BaseTable &baseGlyphs,
+                    const UlfFont::OverlayTable &overlayGlyphs, const UnicodeMap &unicodeMap,
+                    std::shared_ptr<const UlfFont::SpanIndex> index)
+        : m_version(version), m_baseGlyphs(baseGlyphs), m_overlayGlyphs(overlayGlyphs),
+          m_unicodeMap(unicodeMap), m_index(std::move(index)) {}
+
+    uint64_t m_version = 0;
+    UlfFont::BaseTable m_baseGlyphs;
+    UlfFont::OverlayTable m_overlayGlyphs;
+    UnicodeMap m_unicodeMap;
+    std::shared_ptr<const UlfFont::SpanIndex> m_index;
+};
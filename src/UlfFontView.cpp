@@ -0,0 +1,132 @@
+#include "UlfFontView.h"
+
+UlfFontView::~UlfFontView()
+{
+    close();
+}
+
+bool UlfFontView::open(const QString &path)
+{
+    close();
+
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly))
+        return false;
+
+    m_size = m_file.size();
+    if (m_size < UlfFont::MAP_OFFSET) {
+        close();
+        return false;
+    }
+
+    m_data = m_file.map(0, m_size);
+    if (!m_data) {
+        m_fallback = m_file.readAll();
+        m_size = m_fallback.size();
+        m_data = reinterpret_cast<const uint8_t *>(m_fallback.constData());
+    }
+
+    if (m_size < UlfFont::MAP_OFFSET || !parse()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool UlfFontView::openData(const QByteArray &data)
+{
+    close();
+
+    m_fallback = data;
+    m_size = m_fallback.size();
+    m_data = reinterpret_cast<const uint8_t *>(m_fallback.constData());
+
+    if (m_size < UlfFont::MAP_OFFSET || !parse()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void UlfFontView::close()
+{
+    m_blocks.clear();
+    m_data = nullptr;
+    m_size = 0;
+    m_fallback.clear();
+    m_file.close();  // also drops the mapping
+}
+
+bool UlfFontView::parse()
+{
+    qint64 pos = UlfFont::MAP_OFFSET;
+    while (pos + UlfFont::BLOCK_HEADER_BYTES <= m_size) {
+        const uint8_t *header = m_data + pos;
+        int count = header[3];
+        pos += UlfFont::BLOCK_HEADER_BYTES;
+
+        if (count == 0)
+            break;
+
+        // A truncated last block keeps the entries that are actually there
+        qint64 available = (m_size - pos) / UlfFont::MAP_ENTRY_BYTES;
+        Block block;
+        block.startCodepoint = header[0] | (header[1] << 8) | (header[2] << 16);
+        block.entryCount = (int)qMin<qint64>(count, available);
+        block.entries = m_data + pos;
+        m_blocks.push_back(block);
+
+        pos += (qint64)block.entryCount * UlfFont::MAP_ENTRY_BYTES;
+    }
+    return true;
+}
+
+const uint8_t *UlfFontView::baseGlyph(int glyphIndex) const
+{
+    return m_data + UlfFont::BASE_OFFSET + glyphIndex * UlfFont::BASE_GLYPH_BYTES;
+}
+
+const uint8_t *UlfFontView::overlayGlyph(int glyphIndex) const
+{
+    return m_data + UlfFont::OVERLAY_OFFSET + glyphIndex * UlfFont::OVERLAY_GLYPH_BYTES;
+}
+
+UnicodeMapEntry UlfFontView::entry(int blockIndex, int entryIndex) const
+{
+    return UlfFont::decodeEntry(m_blocks[blockIndex].entries + entryIndex * UlfFont::MAP_ENTRY_BYTES);
+}
+
+int UlfFontView::basePixel(int glyphIndex, int x, int y) const
+{
+    if (!m_data || glyphIndex < 0 || glyphIndex >= UlfFont::BASE_COUNT)
+        return 0;
+    return UlfFont::basePixel(baseGlyph(glyphIndex), x, y);
+}
+
+int UlfFontView::overlayPixel(int glyphIndex, int x, int y) const
+{
+    if (!m_data || glyphIndex < 0 || glyphIndex >= UlfFont::OVERLAY_COUNT)
+        return 0;
+    return UlfFont::overlayPixel(overlayGlyph(glyphIndex), x, y);
+}
+
+int UlfFontView::compositedPixel(const UnicodeMapEntry &entry, int x, int y) const
+{
+    if (!m_data)
+        return 0;
+    const uint8_t *overlay = entry.overlayIndex < UlfFont::OVERLAY_COUNT
+        ? overlayGlyph(entry.overlayIndex) : nullptr;
+    return UlfFont::compositedPixel(baseGlyph(entry.baseIndex), overlay, entry, x, y);
+}
+
+void UlfFontView::compositeGlyph(const UnicodeMapEntry &entry, uint32_t rows[UlfFont::GLYPH_H]) const
+{
+    static const uint8_t emptyGlyph[UlfFont::OVERLAY_GLYPH_BYTES] = {};
+    if (!m_data) {
+        UlfFont::compositeGlyph(emptyGlyph, emptyGlyph, entry, rows);
+        return;
+    }
+    const uint8_t *overlay = entry.overlayIndex < UlfFont::OVERLAY_COUNT
+        ? overlayGlyph(entry.overlayIndex) : emptyGlyph;
+    UlfFont::compositeGlyph(baseGlyph(entry.baseIndex), overlay, entry, rows);
+}
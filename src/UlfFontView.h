@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <QByteArray>
+#include <QFile>
+#include "UlfFont.h"
+
+// Read-only view of a .ulf file. The file is memory-mapped and the glyph
+// tables and map entries are read in place; only block headers are indexed,
+// so opening a font costs one small allocation per block.
+class UlfFontView {
+public:
+    struct Block {
+        uint32_t startCodepoint = 0;
+        int entryCount = 0;
+        const uint8_t *entries = nullptr;  // entryCount x MAP_ENTRY_BYTES, as on disk
+    };
+
+    UlfFontView() = default;
+    ~UlfFontView();
+    UlfFontView(const UlfFontView &) = delete;
+    UlfFontView &operator=(const UlfFontView &) = delete;
+
+    bool open(const QString &path);
+    // File image already in memory (shared, not copied)
+    bool openData(const QByteArray &data);
+    void close();
+    bool isOpen() const { return m_data != nullptr; }
+
+    const uint8_t *baseGlyph(int glyphIndex) const;
+    const uint8_t *overlayGlyph(int glyphIndex) const;
+    const std::vector<Block> &blocks() const { return m_blocks; }
+    UnicodeMapEntry entry(int blockIndex, int entryIndex) const;
+
+    // Same answers as the UlfFont accessors of the same name
+    int basePixel(int glyphIndex, int x, int y) const;
+    int overlayPixel(int glyphIndex, int x, int y) const;
+    int compositedPixel(const UnicodeMapEntry &entry, int x, int y) const;
+    void compositeGlyph(const UnicodeMapEntry &entry, uint32_t rows[UlfFont::GLYPH_H]) const;
+
+private:
+    bool parse();
+
+    QFile m_file;
+    QByteArray m_fallback;  // used when the file system can't map
+    const uint8_t *m_data = nullptr;
+    qint64 m_size = 0;
+    std::vector<Block> m_blocks;
+};
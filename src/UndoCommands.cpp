@@ -1,82 +1,228 @@
 #include "UndoCommands.h"
+#include "FontNotifier.h"
+#include <cstring>
 
-// --- SetPixelCommand ---
+namespace {
 
-SetPixelCommand::SetPixelCommand(UlfFont *font, PixelLayer layer, int glyphIndex,
-                                 int x, int y, int newValue, QUndoCommand *parent)
-    : QUndoCommand(parent), m_font(font), m_layer(layer),
-      m_glyphIndex(glyphIndex), m_x(x), m_y(y), m_newValue(newValue)
+// Record layouts in the HistoryStore. Glyph deltas: per glyph a layer
+// byte, 16-bit index, then the before and after images at the layer's
+// size. Blocks: 32-bit start, 32-bit count, then per entry base index,
+// 16-bit overlay index and a flag byte.
+void appendU16(QByteArray &data, uint32_t value)
 {
-    if (m_layer == Base)
-        m_oldValue = m_font->basePixel(m_glyphIndex, m_x, m_y);
-    else
-        m_oldValue = m_font->overlayPixel(m_glyphIndex, m_x, m_y);
+    data += char(value & 0xFF);
+    data += char((value >> 8) & 0xFF);
+}
+
+void appendU32(QByteArray &data, uint32_t value)
+{
+    appendU16(data, value & 0xFFFF);
+    appendU16(data, value >> 16);
+}
 
-    setText(m_layer == Base ? "Edit base pixel" : "Edit overlay pixel");
+uint32_t readU16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
 }
 
-void SetPixelCommand::undo()
+uint32_t readU32(const uint8_t *p)
 {
-    if (m_layer == Base)
-        m_font->setBasePixel(m_glyphIndex, m_x, m_y, m_oldValue);
-    else
-        m_font->setOverlayPixel(m_glyphIndex, m_x, m_y, m_oldValue);
+    return readU16(p) | (readU16(p + 2) << 16);
 }
 
-void SetPixelCommand::redo()
+constexpr int BLOCK_RECORD_HEADER = 8;
+constexpr int BLOCK_RECORD_ENTRY = 4;
+
+HistoryStore::RecordId storeBlock(const UnicodeMapBlock &block)
 {
-    if (m_layer == Base)
-        m_font->setBasePixel(m_glyphIndex, m_x, m_y, m_newValue);
-    else
-        m_font->setOverlayPixel(m_glyphIndex, m_x, m_y, m_newValue);
+    QByteArray data;
+    data.reserve(BLOCK_RECORD_HEADER + (int)block.entries.size() * BLOCK_RECORD_ENTRY);
+    appendU32(data, block.startCodepoint);
+    appendU32(data, (uint32_t)block.entries.size());
+    for (const auto &entry : block.entries) {
+        data += char(entry.baseIndex);
+        appendU16(data, entry.overlayIndex);
+        data += char((entry.reverse ? 1 : 0) | (entry.noGlyph ? 2 : 0)
+                     | (entry.vflip ? 4 : 0) | (entry.hflip ? 8 : 0));
+    }
+    return HistoryStore::instance().add(data);
 }
 
-bool SetPixelCommand::mergeWith(const QUndoCommand *other)
+// For a command whose record is gone. The stack's owner drops the whole
+// history: dropping just this command would leave the ones around it
+// undoing and redoing against a font they weren't recorded on.
+void reportLost(UlfFont *font, const QString &commandText)
 {
-    auto *o = dynamic_cast<const SetPixelCommand *>(other);
-    if (!o) return false;
-    if (o->m_layer != m_layer || o->m_glyphIndex != m_glyphIndex ||
-        o->m_x != m_x || o->m_y != m_y)
+    if (FontNotifier *notifier = font->notifier())
+        emit notifier->historyLost(commandText);
+}
+
+// False if the record can't be read back whole
+bool loadBlock(HistoryStore::RecordId record, UnicodeMapBlock &block)
+{
+    QByteArray data;
+    if (!HistoryStore::instance().get(record, data) || data.size() < BLOCK_RECORD_HEADER)
         return false;
-    m_newValue = o->m_newValue;
+    const auto *p = reinterpret_cast<const uint8_t *>(data.constData());
+    block.startCodepoint = readU32(p);
+    uint32_t count = readU32(p + 4);
+    if ((qint64)data.size() != BLOCK_RECORD_HEADER + (qint64)count * BLOCK_RECORD_ENTRY)
+        return false;
+    block.entries.resize(count);
+    p += BLOCK_RECORD_HEADER;
+    for (auto &entry : block.entries) {
+        entry.baseIndex = p[0];
+        entry.overlayIndex = (uint16_t)readU16(p + 1);
+        entry.reverse = p[3] & 1;
+        entry.noGlyph = p[3] & 2;
+        entry.vflip = p[3] & 4;
+        entry.hflip = p[3] & 8;
+        p += BLOCK_RECORD_ENTRY;
+    }
     return true;
 }
 
+} // namespace
+
+// --- GlyphEditCommand ---
+
+bool GlyphEditCommand::GlyphDelta::isNoOp() const
+{
+    return std::memcmp(before, after, byteCount()) == 0;
+}
+
+GlyphEditCommand::GlyphDelta GlyphEditCommand::capture(const UlfFont *font, Layer layer,
+                                                        int glyphIndex)
+{
+    GlyphDelta delta;
+    delta.layer = layer;
+    delta.glyphIndex = glyphIndex;
+    captureAfter(font, delta);
+    std::memcpy(delta.before, delta.after, sizeof(delta.before));
+    return delta;
+}
+
+void GlyphEditCommand::captureAfter(const UlfFont *font, GlyphDelta &delta)
+{
+    const uint8_t *bytes = delta.layer == Base ? font->baseGlyphs[delta.glyphIndex]
+                                               : font->overlayGlyphs[delta.glyphIndex];
+    std::memcpy(delta.after, bytes, delta.byteCount());
+}
+
+GlyphEditCommand::GlyphEditCommand(UlfFont *font, const QString &text,
+                                   const std::vector<GlyphDelta> &deltas, QUndoCommand *parent)
+    : QUndoCommand(text, parent), m_font(font)
+{
+    QByteArray data;
+    data.reserve((int)deltas.size() * (3 + 2 * UlfFont::OVERLAY_GLYPH_BYTES));
+    for (const auto &delta : deltas) {
+        data += char(delta.layer);
+        appendU16(data, delta.glyphIndex);
+        data.append(reinterpret_cast<const char *>(delta.before), delta.byteCount());
+        data.append(reinterpret_cast<const char *>(delta.after), delta.byteCount());
+    }
+    m_record = HistoryStore::instance().add(data);
+}
+
+GlyphEditCommand::~GlyphEditCommand()
+{
+    HistoryStore::instance().release(m_record);
+}
+
+void GlyphEditCommand::undo()
+{
+    apply(false);
+}
+
+void GlyphEditCommand::redo()
+{
+    apply(true);
+}
+
+void GlyphEditCommand::apply(bool after)
+{
+    QByteArray data;
+    if (!HistoryStore::instance().get(m_record, data)) {
+        qWarning("GlyphEditCommand: glyph images lost, \"%s\" can't be %s",
+                 qPrintable(text()), after ? "redone" : "undone");
+        reportLost(m_font, text());
+        return;
+    }
+    const auto *p = reinterpret_cast<const uint8_t *>(data.constData());
+    const uint8_t *end = p + data.size();
+    while (end - p >= 3) {
+        Layer layer = Layer(p[0]);
+        int glyphIndex = (int)readU16(p + 1);
+        int bytes = layer == Base ? UlfFont::BASE_GLYPH_BYTES : UlfFont::OVERLAY_GLYPH_BYTES;
+        p += 3;
+        if (end - p < 2 * bytes)
+            break;
+        const uint8_t *image = after ? p + bytes : p;
+        if (layer == Base)
+            m_font->setBaseGlyph(glyphIndex, image);
+        else
+            m_font->setOverlayGlyph(glyphIndex, image);
+        p += 2 * bytes;
+    }
+}
+
 // --- AddMapBlockCommand ---
 
 AddMapBlockCommand::AddMapBlockCommand(UlfFont *font, int blockIndex,
                                        const UnicodeMapBlock &block, QUndoCommand *parent)
     : QUndoCommand("Add map block", parent), m_font(font),
-      m_blockIndex(blockIndex), m_block(block)
+      m_blockIndex(blockIndex), m_block(storeBlock(block))
+{
+}
+
+AddMapBlockCommand::~AddMapBlockCommand()
 {
+    HistoryStore::instance().release(m_block);
 }
 
 void AddMapBlockCommand::undo()
 {
-    m_font->unicodeMap.erase(m_font->unicodeMap.begin() + m_blockIndex);
+    m_font->removeBlock(m_blockIndex);
 }
 
 void AddMapBlockCommand::redo()
 {
-    m_font->unicodeMap.insert(m_font->unicodeMap.begin() + m_blockIndex, m_block);
+    UnicodeMapBlock block;
+    if (!loadBlock(m_block, block)) {
+        qWarning("AddMapBlockCommand: block lost, can't be redone");
+        reportLost(m_font, text());
+        return;
+    }
+    m_font->insertBlock(m_blockIndex, block);
 }
 
 // --- RemoveMapBlockCommand ---
 
 RemoveMapBlockCommand::RemoveMapBlockCommand(UlfFont *font, int blockIndex, QUndoCommand *parent)
-    : QUndoCommand("Remove map block", parent), m_font(font), m_blockIndex(blockIndex)
+    : QUndoCommand("Remove map block", parent), m_font(font), m_blockIndex(blockIndex),
+      m_block(storeBlock(font->unicodeMap[blockIndex]))
+{
+}
+
+RemoveMapBlockCommand::~RemoveMapBlockCommand()
 {
-    m_block = m_font->unicodeMap[blockIndex];
+    HistoryStore::instance().release(m_block);
 }
 
 void RemoveMapBlockCommand::undo()
 {
-    m_font->unicodeMap.insert(m_font->unicodeMap.begin() + m_blockIndex, m_block);
+    UnicodeMapBlock block;
+    if (!loadBlock(m_block, block)) {
+        qWarning("RemoveMapBlockCommand: removed block lost, can't be undone");
+        reportLost(m_font, text());
+        return;
+    }
+    m_font->insertBlock(m_blockIndex, block);
 }
 
 void RemoveMapBlockCommand::redo()
 {
-    m_font->unicodeMap.erase(m_font->unicodeMap.begin() + m_blockIndex);
+    m_font->removeBlock(m_blockIndex);
 }
 
 // --- AddMapEntryCommand ---
@@ -90,14 +236,12 @@ AddMapEntryCommand::AddMapEntryCommand(UlfFont *font, int blockIndex, int entryI
 
 void AddMapEntryCommand::undo()
 {
-    auto &entries = m_font->unicodeMap[m_blockIndex].entries;
-    entries.erase(entries.begin() + m_entryIndex);
+    m_font->removeEntry(m_blockIndex, m_entryIndex);
 }
 
 void AddMapEntryCommand::redo()
 {
-    auto &entries = m_font->unicodeMap[m_blockIndex].entries;
-    entries.insert(entries.begin() + m_entryIndex, m_entry);
+    m_font->insertEntry(m_blockIndex, m_entryIndex, m_entry);
 }
 
 // --- RemoveMapEntryCommand ---
@@ -112,14 +256,12 @@ RemoveMapEntryCommand::RemoveMapEntryCommand(UlfFont *font, int blockIndex,
 
 void RemoveMapEntryCommand::undo()
 {
-    auto &entries = m_font->unicodeMap[m_blockIndex].entries;
-    entries.insert(entries.begin() + m_entryIndex, m_entry);
+    m_font->insertEntry(m_blockIndex, m_entryIndex, m_entry);
 }
 
 void RemoveMapEntryCommand::redo()
 {
-    auto &entries = m_font->unicodeMap[m_blockIndex].entries;
-    entries.erase(entries.begin() + m_entryIndex);
+    m_font->removeEntry(m_blockIndex, m_entryIndex);
 }
 
 // --- EditMapEntryCommand ---
@@ -134,12 +276,12 @@ EditMapEntryCommand::EditMapEntryCommand(UlfFont *font, int blockIndex, int entr
 
 void EditMapEntryCommand::undo()
 {
-    m_font->unicodeMap[m_blockIndex].entries[m_entryIndex] = m_oldEntry;
+    m_font->setEntry(m_blockIndex, m_entryIndex, m_oldEntry);
 }
 
 void EditMapEntryCommand::redo()
 {
-    m_font->unicodeMap[m_blockIndex].entries[m_entryIndex] = m_newEntry;
+    m_font->setEntry(m_blockIndex, m_entryIndex, m_newEntry);
 }
 
 // --- EditMapBlockStartCommand ---
@@ -154,10 +296,10 @@ EditMapBlockStartCommand::EditMapBlockStartCommand(UlfFont *font, int blockIndex
 
 void EditMapBlockStartCommand::undo()
 {
-    m_font->unicodeMap[m_blockIndex].startCodepoint = m_oldStart;
+    m_font->setBlockStart(m_blockIndex, m_oldStart);
 }
 
 void EditMapBlockStartCommand::redo()
 {
-    m_font->unicodeMap[m_blockIndex].startCodepoint = m_newStart;
+    m_font->setBlockStart(m_blockIndex, m_newStart);
 }
@@ -1,49 +1,73 @@
 #pragma once
 #include <QUndoCommand>
+#include <vector>
+#include "HistoryStore.h"
 #include "UlfFont.h"
 
-class SetPixelCommand : public QUndoCommand {
+// Before/after images of whole glyphs. A paint stroke records the one glyph
+// it touched; bulk operations record every touched glyph in one command.
+// The images live in the HistoryStore, which may spill them to disk.
+class GlyphEditCommand : public QUndoCommand {
 public:
-    enum PixelLayer { Base, Overlay };
-
-    SetPixelCommand(UlfFont *font, PixelLayer layer, int glyphIndex,
-                    int x, int y, int newValue, QUndoCommand *parent = nullptr);
+    enum Layer { Base, Overlay };
+
+    struct GlyphDelta {
+        Layer layer = Base;
+        int glyphIndex = 0;
+        uint8_t before[UlfFont::OVERLAY_GLYPH_BYTES]{};
+        uint8_t after[UlfFont::OVERLAY_GLYPH_BYTES]{};
+
+        int byteCount() const
+        {
+            return layer == Base ? UlfFont::BASE_GLYPH_BYTES : UlfFont::OVERLAY_GLYPH_BYTES;
+        }
+        bool isNoOp() const;
+    };
+
+    // Delta with before (and after) set to the glyph's current contents
+    static GlyphDelta capture(const UlfFont *font, Layer layer, int glyphIndex);
+    // Copy the glyph's current contents into delta.after
+    static void captureAfter(const UlfFont *font, GlyphDelta &delta);
+
+    GlyphEditCommand(UlfFont *font, const QString &text, const std::vector<GlyphDelta> &deltas,
+                     QUndoCommand *parent = nullptr);
+    ~GlyphEditCommand() override;
 
     void undo() override;
     void redo() override;
-    int id() const override { return 1; }
-    bool mergeWith(const QUndoCommand *other) override;
 
 private:
+    void apply(bool after);
+
     UlfFont *m_font;
-    PixelLayer m_layer;
-    int m_glyphIndex, m_x, m_y;
-    int m_oldValue, m_newValue;
+    HistoryStore::RecordId m_record;
 };
 
 class AddMapBlockCommand : public QUndoCommand {
 public:
     AddMapBlockCommand(UlfFont *font, int blockIndex, const UnicodeMapBlock &block,
                        QUndoCommand *parent = nullptr);
+    ~AddMapBlockCommand() override;
     void undo() override;
     void redo() override;
 
 private:
     UlfFont *m_font;
     int m_blockIndex;
-    UnicodeMapBlock m_block;
+    HistoryStore::RecordId m_block;  // encoded UnicodeMapBlock
 };
 
 class RemoveMapBlockCommand : public QUndoCommand {
 public:
     RemoveMapBlockCommand(UlfFont *font, int blockIndex, QUndoCommand *parent = nullptr);
+    ~RemoveMapBlockCommand() override;
     void undo() override;
     void redo() override;
 
 private:
     UlfFont *m_font;
     int m_blockIndex;
-    UnicodeMapBlock m_block;
+    HistoryStore::RecordId m_block;  // encoded UnicodeMapBlock
 };
 
 class AddMapEntryCommand : public QUndoCommand {
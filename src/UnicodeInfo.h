@@ -1,45 +1,60 @@
 #pragma once
+#include <cstdint>
 #include <QString>
 
+// Lookups below use tables generated at build time from the Unicode
+// Character Database (tools/gen_unicode_data.py); none of them allocate
+// except the QString wrappers.
+
+struct UnicodeBlock {
+    uint32_t first;
+    uint32_t last;
+    const char *name;
+};
+
+// General category, in UnicodeData.txt order
+enum class UnicodeCategory : uint8_t {
+    Lu, Ll, Lt, Lm, Lo, Mn, Mc, Me, Nd, Nl, No,
+    Pc, Pd, Ps, Pe, Pi, Pf, Po, Sm, Sc, Sk, So,
+    Zs, Zl, Zp, Cc, Cf, Cs, Co, Cn
+};
+
+// Block containing cp, or nullptr outside all blocks
+const UnicodeBlock *unicodeBlock(uint32_t cp);
+// All blocks, ascending
+int unicodeBlockCount();
+const UnicodeBlock &unicodeBlockAt(int index);
+
+UnicodeCategory unicodeCategory(uint32_t cp);
+const char *unicodeCategoryCode(UnicodeCategory category);  // "Lu"
+const char *unicodeCategoryName(UnicodeCategory category);  // "Uppercase Letter"
+
+// Version of the Unicode data the tables were built from
+const char *unicodeVersion();
+
+// Large enough for any name, terminator included
+constexpr int UNICODE_NAME_BUFFER = 128;
+
+// Character name, NUL-terminated, into buf. Code points without a name get
+// a label in angle brackets instead ("<control-0007>", "<unassigned-0378>").
+// Returns the length, or 0 if buf is too small.
+int unicodeCharName(uint32_t cp, char *buf, int size);
+
+// Stored names as word ids, for building search indexes. Names generated
+// by rule (CJK and Tangut ideographs, Hangul syllables, ...) are not
+// included. Name indexes ascend with code point.
+int unicodeNameWordCount();
+const char *unicodeNameWord(int word);
+int unicodeStoredNameCount();
+uint32_t unicodeStoredNameCodepoint(int nameIndex);
+// Word ids of a stored name into words (UNICODE_NAME_BUFFER / 2 is always
+// enough); returns how many
+int unicodeStoredNameWords(int nameIndex, int *words);
+
 inline QString unicodeBlockName(uint32_t cp)
 {
-    struct Block { uint32_t start, end; const char *name; };
-    static const Block blocks[] = {
-        {0x0000, 0x007F, "Basic Latin"},
-        {0x0080, 0x00FF, "Latin-1 Supplement"},
-        {0x0100, 0x017F, "Latin Extended-A"},
-        {0x0180, 0x024F, "Latin Extended-B"},
-        {0x0250, 0x02AF, "IPA Extensions"},
-        {0x02B0, 0x02FF, "Spacing Modifier Letters"},
-        {0x0300, 0x036F, "Combining Diacritical Marks"},
-        {0x0370, 0x03FF, "Greek and Coptic"},
-        {0x0400, 0x04FF, "Cyrillic"},
-        {0x0500, 0x052F, "Cyrillic Supplement"},
-        {0x0530, 0x058F, "Armenian"},
-        {0x0590, 0x05FF, "Hebrew"},
-        {0x0600, 0x06FF, "Arabic"},
-        {0x2000, 0x206F, "General Punctuation"},
-        {0x2070, 0x209F, "Superscripts and Subscripts"},
-        {0x20A0, 0x20CF, "Currency Symbols"},
-        {0x2100, 0x214F, "Letterlike Symbols"},
-        {0x2150, 0x218F, "Number Forms"},
-        {0x2190, 0x21FF, "Arrows"},
-        {0x2200, 0x22FF, "Mathematical Operators"},
-        {0x2300, 0x23FF, "Miscellaneous Technical"},
-        {0x2500, 0x257F, "Box Drawing"},
-        {0x2580, 0x259F, "Block Elements"},
-        {0x25A0, 0x25FF, "Geometric Shapes"},
-        {0x2600, 0x26FF, "Miscellaneous Symbols"},
-        {0xE000, 0xF8FF, "Private Use Area"},
-        {0xFB00, 0xFB06, "Alphabetic Presentation Forms"},
-        {0xFE00, 0xFE0F, "Variation Selectors"},
-        {0xFFFD, 0xFFFD, "Specials"},
-    };
-    for (const auto &b : blocks) {
-        if (cp >= b.start && cp <= b.end)
-            return QString::fromLatin1(b.name);
-    }
-    return QString();
+    const UnicodeBlock *block = unicodeBlock(cp);
+    return block ? QString::fromLatin1(block->name) : QString();
 }
 
 inline QString unicodeCodepointStr(uint32_t cp)
@@ -55,8 +70,12 @@ inline QString unicodeCharStr(uint32_t cp)
     return QString::fromUcs4(&cp32, 1);
 }
 
-// Defined in UnicodeNames.cpp — ICU-based character name lookup
-QString unicodeCharName(uint32_t cp);
+inline QString unicodeCharName(uint32_t cp)
+{
+    char buf[UNICODE_NAME_BUFFER];
+    int len = unicodeCharName(cp, buf, sizeof(buf));
+    return QString::fromLatin1(buf, len);
+}
 
 // Defined in UnicodeNames.cpp — find a font family that has a glyph for the codepoint
 // Returns empty string if no suitable font found
@@ -1,8 +1,10 @@
 #include "UnicodeMapEditor.h"
+#include "UnicodeMapModel.h"
 #include "UlfFont.h"
 #include "UndoCommands.h"
 #include "UnicodeInfo.h"
-#include <QTreeWidget>
+#include "UnicodeNameIndex.h"
+#include <QTreeView>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QPushButton>
@@ -15,18 +17,11 @@
 #include <QSpinBox>
 #include <QLabel>
 #include <QLineEdit>
+#include <QListWidget>
 #include <QKeyEvent>
 
-enum Column {
-    ColCodepoint = 0,
-    ColChar,
-    ColBase,
-    ColOverlay,
-    ColReverse,
-    ColHFlip,
-    ColVFlip,
-    ColCount
-};
+// Search results shown at once; the rest are only counted
+static constexpr int SEARCH_RESULT_LIMIT = 100;
 
 UnicodeMapEditor::UnicodeMapEditor(QWidget *parent)
     : QWidget(parent)
@@ -34,6 +29,25 @@ UnicodeMapEditor::UnicodeMapEditor(QWidget *parent)
     auto *layout = new QVBoxLayout(this);
     layout->setContentsMargins(0, 0, 0, 0);
 
+    // Find by name or codepoint; results update on every keystroke
+    m_searchEdit = new QLineEdit;
+    m_searchEdit->setPlaceholderText(tr("Find character by name or U+hex"));
+    m_searchEdit->setClearButtonEnabled(true);
+    layout->addWidget(m_searchEdit);
+
+    m_searchResults = new QListWidget;
+    m_searchResults->setUniformItemSizes(true);
+    m_searchResults->setMaximumHeight(160);
+    m_searchResults->hide();
+    layout->addWidget(m_searchResults);
+
+    connect(m_searchEdit, &QLineEdit::textChanged, this, &UnicodeMapEditor::updateSearchResults);
+    connect(m_searchEdit, &QLineEdit::returnPressed, this, [this]() {
+        activateSearchResult(m_searchResults->currentItem());
+    });
+    connect(m_searchResults, &QListWidget::itemActivated, this, &UnicodeMapEditor::activateSearchResult);
+    m_searchEdit->installEventFilter(this);
+
     // Toolbar
     auto *toolbar = new QHBoxLayout;
     auto *addBlockBtn = new QPushButton(tr("Add Block"));
@@ -50,46 +64,90 @@ UnicodeMapEditor::UnicodeMapEditor(QWidget *parent)
     connect(removeBtn, &QPushButton::clicked, this, &UnicodeMapEditor::removeSelected);
 
     // Tree
-    m_tree = new QTreeWidget;
-    m_tree->setColumnCount(ColCount);
-    m_tree->setHeaderLabels({tr("Codepoint"), tr("Char"), tr("Base"), tr("Ovl"),
-                             tr("Rev"), tr("HF"), tr("VF")});
+    m_model = new UnicodeMapModel(this);
+    m_tree = new QTreeView;
+    m_tree->setModel(m_model);
+    m_tree->setUniformRowHeights(true);
     m_tree->header()->setStretchLastSection(false);
-    m_tree->header()->setSectionResizeMode(ColCodepoint, QHeaderView::Stretch);
-    m_tree->header()->setSectionResizeMode(ColChar, QHeaderView::Fixed);
-    m_tree->header()->setSectionResizeMode(ColBase, QHeaderView::Fixed);
-    m_tree->header()->setSectionResizeMode(ColOverlay, QHeaderView::Fixed);
-    m_tree->header()->setSectionResizeMode(ColReverse, QHeaderView::Fixed);
-    m_tree->header()->setSectionResizeMode(ColHFlip, QHeaderView::Fixed);
-    m_tree->header()->setSectionResizeMode(ColVFlip, QHeaderView::Fixed);
-    m_tree->header()->resizeSection(ColChar, 36);
-    m_tree->header()->resizeSection(ColBase, 40);
-    m_tree->header()->resizeSection(ColOverlay, 40);
-    m_tree->header()->resizeSection(ColReverse, 34);
-    m_tree->header()->resizeSection(ColHFlip, 30);
-    m_tree->header()->resizeSection(ColVFlip, 30);
+    m_tree->header()->setSectionResizeMode(UnicodeMapModel::ColCodepoint, QHeaderView::Stretch);
+    m_tree->header()->setSectionResizeMode(UnicodeMapModel::ColChar, QHeaderView::Fixed);
+    m_tree->header()->setSectionResizeMode(UnicodeMapModel::ColBase, QHeaderView::Fixed);
+    m_tree->header()->setSectionResizeMode(UnicodeMapModel::ColOverlay, QHeaderView::Fixed);
+    m_tree->header()->setSectionResizeMode(UnicodeMapModel::ColReverse, QHeaderView::Fixed);
+    m_tree->header()->setSectionResizeMode(UnicodeMapModel::ColHFlip, QHeaderView::Fixed);
+    m_tree->header()->setSectionResizeMode(UnicodeMapModel::ColVFlip, QHeaderView::Fixed);
+    m_tree->header()->resizeSection(UnicodeMapModel::ColChar, 36);
+    m_tree->header()->resizeSection(UnicodeMapModel::ColBase, 40);
+    m_tree->header()->resizeSection(UnicodeMapModel::ColOverlay, 40);
+    m_tree->header()->resizeSection(UnicodeMapModel::ColReverse, 34);
+    m_tree->header()->resizeSection(UnicodeMapModel::ColHFlip, 30);
+    m_tree->header()->resizeSection(UnicodeMapModel::ColVFlip, 30);
     m_tree->setRootIsDecorated(true);
     m_tree->setSelectionMode(QAbstractItemView::SingleSelection);
     m_tree->setMinimumWidth(300);
     layout->addWidget(m_tree);
 
+    // Integrity problems, hidden while the map is clean
+    m_problemLabel = new QLabel;
+    m_problemLabel->setWordWrap(true);
+    m_problemLabel->hide();
+    layout->addWidget(m_problemLabel);
+    connect(m_problemLabel, &QLabel::linkActivated, this, &UnicodeMapEditor::selectNextProblem);
+
     m_tree->installEventFilter(this);
 
-    connect(m_tree, &QTreeWidget::currentItemChanged, this, &UnicodeMapEditor::onSelectionChanged);
-    connect(m_tree, &QTreeWidget::itemChanged, this, &UnicodeMapEditor::onItemChanged);
+    connect(m_tree->selectionModel(), &QItemSelectionModel::currentChanged,
+            this, &UnicodeMapEditor::onSelectionChanged);
+    connect(m_tree, &QTreeView::expanded, this, [this](const QModelIndex &index) {
+        auto [bi, ei] = m_model->blockEntry(index);
+        if (bi >= 0 && ei < 0)
+            emit blockExpanded(bi);
+    });
+    connect(m_model, &UnicodeMapModel::mapModified, this, &UnicodeMapEditor::mapModified);
+    connect(m_model, &UnicodeMapModel::validationChanged, this, &UnicodeMapEditor::updateProblemLabel);
+    connect(m_model, &QAbstractItemModel::modelAboutToBeReset, this, &UnicodeMapEditor::saveViewState);
+    connect(m_model, &QAbstractItemModel::modelReset, this, &UnicodeMapEditor::restoreViewState);
+}
+
+void UnicodeMapEditor::setFont(UlfFont *font)
+{
+    m_font = font;
+    m_model->setFont(font);
+}
+
+void UnicodeMapEditor::setUndoStack(QUndoStack *stack)
+{
+    m_undoStack = stack;
+    m_model->setUndoStack(stack);
 }
 
 bool UnicodeMapEditor::eventFilter(QObject *obj, QEvent *event)
 {
+    if (obj == m_searchEdit && event->type() == QEvent::KeyPress) {
+        // Arrow keys move through the results without leaving the search box
+        auto *ke = static_cast<QKeyEvent *>(event);
+        int row = m_searchResults->currentRow();
+        if (ke->key() == Qt::Key_Down || ke->key() == Qt::Key_Up) {
+            row += ke->key() == Qt::Key_Down ? 1 : -1;
+            if (row >= 0 && row < m_searchResults->count()
+                && (m_searchResults->item(row)->flags() & Qt::ItemIsEnabled))
+                m_searchResults->setCurrentRow(row);
+            return true;
+        }
+        if (ke->key() == Qt::Key_Escape && !m_searchEdit->text().isEmpty()) {
+            m_searchEdit->clear();
+            return true;
+        }
+    }
     if (obj == m_tree && event->type() == QEvent::KeyPress) {
         auto *ke = static_cast<QKeyEvent *>(event);
         if (ke->key() == Qt::Key_Left) {
-            auto *item = m_tree->currentItem();
-            if (item && item->parent()) {
+            QModelIndex current = m_tree->currentIndex();
+            if (current.isValid() && current.parent().isValid()) {
                 // Child entry: collapse and select the parent block
-                auto *parent = item->parent();
-                m_tree->collapseItem(parent);
-                m_tree->setCurrentItem(parent);
+                QModelIndex parent = current.parent();
+                m_tree->collapse(parent);
+                m_tree->setCurrentIndex(parent);
                 return true;
             }
         }
@@ -99,145 +157,205 @@ bool UnicodeMapEditor::eventFilter(QObject *obj, QEvent *event)
 
 void UnicodeMapEditor::rebuild()
 {
-    m_rebuilding = true;
-    m_tree->clear();
+    m_model->reload();
+}
 
-    if (!m_font) {
-        m_rebuilding = false;
-        return;
-    }
+void UnicodeMapEditor::setEntry(int blockIndex, int entryIndex, const UnicodeMapEntry &entry)
+{
+    m_model->setEntry(blockIndex, entryIndex, entry);
+}
 
-    for (int bi = 0; bi < (int)m_font->unicodeMap.size(); ++bi) {
-        const auto &block = m_font->unicodeMap[bi];
-        uint32_t endCp = block.startCodepoint + (uint32_t)block.entries.size() - 1;
-        QString blockName = unicodeBlockName(block.startCodepoint);
-
-        auto *blockItem = new QTreeWidgetItem(m_tree);
-        QString label = QStringLiteral("%1–%2 (%3)")
-            .arg(unicodeCodepointStr(block.startCodepoint))
-            .arg(unicodeCodepointStr(endCp))
-            .arg(block.entries.size());
-        if (!blockName.isEmpty())
-            label += "  " + blockName;
-        blockItem->setText(ColCodepoint, label);
-        blockItem->setData(ColCodepoint, Qt::UserRole, bi);
-        blockItem->setData(ColCodepoint, Qt::UserRole + 1, -1);
-        blockItem->setFlags(blockItem->flags() | Qt::ItemIsEditable);
-
-        populateBlock(blockItem, bi);
+void UnicodeMapEditor::saveViewState()
+{
+    // The map may already have changed; the model still describes the old rows
+    m_savedExpanded.clear();
+    for (int bi = 0; bi < m_model->rowCount(); ++bi) {
+        if (m_tree->isExpanded(m_model->blockIndex(bi)))
+            m_savedExpanded.append(m_model->blockStart(bi));
     }
 
-    m_rebuilding = false;
+    auto [bi, ei] = currentBlockEntry();
+    m_savedBlock = bi;
+    m_savedEntry = ei;
+    m_savedBlockStart = bi >= 0 ? m_model->blockStart(bi) : 0;
 }
 
-void UnicodeMapEditor::populateBlock(QTreeWidgetItem *blockItem, int blockIndex)
+void UnicodeMapEditor::restoreViewState()
 {
-    const auto &block = m_font->unicodeMap[blockIndex];
-    for (int ei = 0; ei < (int)block.entries.size(); ++ei) {
-        const auto &entry = block.entries[ei];
-        uint32_t cp = block.startCodepoint + ei;
-        auto *item = new QTreeWidgetItem(blockItem);
+    if (!m_font)
+        return;
 
-        item->setText(ColCodepoint, unicodeCodepointStr(cp));
+    // Blocks may have moved; find them again by their start codepoint
+    int currentBlock = -1;
+    for (int bi = 0; bi < (int)m_font->unicodeMap.size(); ++bi) {
+        uint32_t start = m_font->unicodeMap[bi].startCodepoint;
+        if (m_savedExpanded.contains(start))
+            expandBlock(bi);
+        if (m_savedBlock >= 0 && currentBlock < 0 && start == m_savedBlockStart)
+            currentBlock = bi;
+    }
+    if (m_savedBlock >= 0 && currentBlock < 0)
+        currentBlock = qMin(m_savedBlock, (int)m_font->unicodeMap.size() - 1);
+    if (currentBlock < 0)
+        return;
 
-        // Show the Unicode character from system font
-        QString ch = unicodeCharStr(cp);
-        item->setText(ColChar, ch);
-        // Use a slightly larger font for the char column
-        QFont charFont = item->font(ColChar);
-        charFont.setPointSize(charFont.pointSize() + 2);
-        item->setFont(ColChar, charFont);
-
-        item->setText(ColBase, QString::number(entry.baseIndex));
-        item->setText(ColOverlay, QString::number(entry.overlayIndex));
-        item->setCheckState(ColReverse, entry.reverse ? Qt::Checked : Qt::Unchecked);
-        item->setCheckState(ColHFlip, entry.hflip ? Qt::Checked : Qt::Unchecked);
-        item->setCheckState(ColVFlip, entry.vflip ? Qt::Checked : Qt::Unchecked);
-        item->setFlags(item->flags() | Qt::ItemIsEditable);
-        item->setData(ColCodepoint, Qt::UserRole, blockIndex);
-        item->setData(ColCodepoint, Qt::UserRole + 1, ei);
+    QModelIndex current = m_model->blockIndex(currentBlock);
+    if (m_savedEntry >= 0) {
+        int count = (int)m_font->unicodeMap[currentBlock].entries.size();
+        if (count > 0) {
+            expandBlock(currentBlock);
+            current = m_model->entryIndex(currentBlock, qMin(m_savedEntry, count - 1));
+        }
     }
+    m_tree->setCurrentIndex(current);
 }
 
-void UnicodeMapEditor::onSelectionChanged()
+void UnicodeMapEditor::updateProblemLabel()
 {
-    auto [bi, ei] = selectedBlockEntry();
-    if (bi >= 0 && ei >= 0)
-        emit entrySelected(bi, ei);
+    int count = m_model->validator().problemBlockCount();
+    if (count == 0) {
+        m_problemLabel->hide();
+        return;
+    }
+    m_problemLabel->setText(tr("%n block(s) need attention. <a href=\"next\">Show</a>", "", count));
+    m_problemLabel->show();
+}
+
+void UnicodeMapEditor::selectNextProblem()
+{
+    // Cycle through flagged blocks starting after the current one
+    int blockCount = m_model->rowCount();
+    int current = currentBlockEntry().first;
+    for (int i = 1; i <= blockCount; ++i) {
+        int bi = (current + i + blockCount) % blockCount;
+        if (m_model->validator().issues(bi)) {
+            QModelIndex idx = m_model->blockIndex(bi);
+            m_tree->setCurrentIndex(idx);
+            m_tree->scrollTo(idx);
+            return;
+        }
+    }
 }
 
-void UnicodeMapEditor::onItemChanged(QTreeWidgetItem *item, int column)
+void UnicodeMapEditor::updateSearchResults()
 {
-    if (m_rebuilding || !m_font || !m_undoStack)
+    m_searchResults->clear();
+    QString query = m_searchEdit->text();
+    if (query.trimmed().isEmpty()) {
+        m_searchResults->hide();
         return;
+    }
 
-    int bi = item->data(ColCodepoint, Qt::UserRole).toInt();
-    int ei = item->data(ColCodepoint, Qt::UserRole + 1).toInt();
+    int total = 0;
+    char name[UNICODE_NAME_BUFFER];
+    for (uint32_t cp : UnicodeNameIndex::instance().search(query, SEARCH_RESULT_LIMIT, &total)) {
+        unicodeCharName(cp, name, sizeof(name));
+        QString ch = unicodeCharStr(cp);
+        auto *item = new QListWidgetItem(QStringLiteral("%1  %2  %3")
+            .arg(unicodeCodepointStr(cp), ch.isEmpty() ? QStringLiteral(" ") : ch,
+                 QLatin1String(name)));
+        item->setData(Qt::UserRole, cp);
+        if (m_font && !m_font->findEntry(cp)) {
+            item->setForeground(palette().color(QPalette::Disabled, QPalette::Text));
+            item->setToolTip(tr("Not mapped yet; choose it to add an entry"));
+        }
+        m_searchResults->addItem(item);
+    }
+    if (total > m_searchResults->count()) {
+        auto *more = new QListWidgetItem(tr("…and %n more", "", total - m_searchResults->count()));
+        more->setFlags(Qt::NoItemFlags);
+        m_searchResults->addItem(more);
+    } else if (total == 0) {
+        auto *none = new QListWidgetItem(tr("No matches"));
+        none->setFlags(Qt::NoItemFlags);
+        m_searchResults->addItem(none);
+    }
+    if (total > 0)
+        m_searchResults->setCurrentRow(0);
+    m_searchResults->show();
+}
 
-    if (ei < 0)
+void UnicodeMapEditor::activateSearchResult(QListWidgetItem *item)
+{
+    if (!item || !(item->flags() & Qt::ItemIsEnabled))
         return;
+    goToCodepoint(item->data(Qt::UserRole).toUInt());
+    m_searchResults->hide();
+    m_tree->setFocus();
+}
 
-    if (bi < 0 || bi >= (int)m_font->unicodeMap.size())
-        return;
-    auto &block = m_font->unicodeMap[bi];
-    if (ei < 0 || ei >= (int)block.entries.size())
+void UnicodeMapEditor::goToCodepoint(uint32_t cp)
+{
+    if (!m_font)
         return;
+    const auto &map = m_font->unicodeMap;
 
-    UnicodeMapEntry newEntry = block.entries[ei];
-    bool changed = false;
-
-    switch (column) {
-    case ColBase: {
-        bool ok;
-        int v = item->text(ColBase).toInt(&ok);
-        if (ok && v >= 0 && v < 256 && v != newEntry.baseIndex) {
-            newEntry.baseIndex = v;
-            changed = true;
+    // Earliest block covering cp, the one findEntry resolves it to
+    for (int bi = 0; bi < (int)map.size(); ++bi) {
+        uint32_t start = map[bi].startCodepoint;
+        if (cp >= start && cp - start < map[bi].entries.size()) {
+            selectEntry(bi, (int)(cp - start));
+            return;
         }
-        break;
     }
-    case ColOverlay: {
-        bool ok;
-        int v = item->text(ColOverlay).toInt(&ok);
-        if (ok && v >= 0 && v < 1024 && v != (int)newEntry.overlayIndex) {
-            newEntry.overlayIndex = v;
-            changed = true;
+
+    if (!m_undoStack)
+        return;
+    for (int bi = 0; bi < (int)map.size(); ++bi) {
+        int count = (int)map[bi].entries.size();
+        if (map[bi].startCodepoint + count == cp && count < UlfFont::MAX_BLOCK_ENTRIES) {
+            m_model->push(new AddMapEntryCommand(m_font, bi, count, UnicodeMapEntry()));
+            selectEntry(bi, count);
+            emit mapModified();
+            return;
         }
-        break;
-    }
-    case ColReverse: {
-        bool v = item->checkState(ColReverse) == Qt::Checked;
-        if (v != newEntry.reverse) { newEntry.reverse = v; changed = true; }
-        break;
-    }
-    case ColHFlip: {
-        bool v = item->checkState(ColHFlip) == Qt::Checked;
-        if (v != newEntry.hflip) { newEntry.hflip = v; changed = true; }
-        break;
-    }
-    case ColVFlip: {
-        bool v = item->checkState(ColVFlip) == Qt::Checked;
-        if (v != newEntry.vflip) { newEntry.vflip = v; changed = true; }
-        break;
-    }
-    default:
-        break;
     }
 
-    if (changed) {
-        m_undoStack->push(new EditMapEntryCommand(m_font, bi, ei, newEntry));
-        emit mapModified();
+    UnicodeMapBlock block;
+    block.startCodepoint = cp;
+    block.entries.resize(1);
+    int insertIdx = blockInsertPosition(cp);
+    m_model->push(new AddMapBlockCommand(m_font, insertIdx, block));
+    selectEntry(insertIdx, 0);
+    emit mapModified();
+}
+
+void UnicodeMapEditor::selectEntry(int blockIndex, int entryIndex)
+{
+    expandBlock(blockIndex);
+    QModelIndex idx = m_model->entryIndex(blockIndex, entryIndex);
+    m_tree->setCurrentIndex(idx);
+    m_tree->scrollTo(idx);
+}
+
+int UnicodeMapEditor::blockInsertPosition(uint32_t startCodepoint) const
+{
+    for (int i = 0; i < (int)m_font->unicodeMap.size(); ++i) {
+        if (m_font->unicodeMap[i].startCodepoint > startCodepoint)
+            return i;
     }
+    return (int)m_font->unicodeMap.size();
+}
+
+void UnicodeMapEditor::expandBlock(int blockIndex)
+{
+    // Make sure the entry rows exist before anyone asks for them
+    QModelIndex idx = m_model->blockIndex(blockIndex);
+    if (m_model->canFetchMore(idx))
+        m_model->fetchMore(idx);
+    m_tree->expand(idx);
 }
 
-std::pair<int,int> UnicodeMapEditor::selectedBlockEntry() const
+void UnicodeMapEditor::onSelectionChanged()
+{
+    auto [bi, ei] = currentBlockEntry();
+    if (bi >= 0 && ei >= 0)
+        emit entrySelected(bi, ei);
+}
+
+std::pair<int,int> UnicodeMapEditor::currentBlockEntry() const
 {
-    auto *item = m_tree->currentItem();
-    if (!item)
-        return {-1, -1};
-    int bi = item->data(ColCodepoint, Qt::UserRole).toInt();
-    int ei = item->data(ColCodepoint, Qt::UserRole + 1).toInt();
-    return {bi, ei};
+    return m_model->blockEntry(m_tree->currentIndex());
 }
 
 void UnicodeMapEditor::addBlock()
@@ -319,17 +437,10 @@ void UnicodeMapEditor::addBlock()
     int count = countSpin->value();
     block.entries.resize(count);
 
-    // Insert in sorted order
-    int insertIdx = (int)m_font->unicodeMap.size();
-    for (int i = 0; i < (int)m_font->unicodeMap.size(); ++i) {
-        if (m_font->unicodeMap[i].startCodepoint > cp) {
-            insertIdx = i;
-            break;
-        }
-    }
+    int insertIdx = blockInsertPosition(cp);
 
-    m_undoStack->push(new AddMapBlockCommand(m_font, insertIdx, block));
-    rebuild();
+    m_model->push(new AddMapBlockCommand(m_font, insertIdx, block));
+    m_tree->setCurrentIndex(m_model->blockIndex(insertIdx));
     emit mapModified();
 }
 
@@ -338,7 +449,7 @@ void UnicodeMapEditor::addEntry()
     if (!m_font || !m_undoStack)
         return;
 
-    auto [bi, ei] = selectedBlockEntry();
+    auto [bi, ei] = currentBlockEntry();
     if (bi < 0) {
         QMessageBox::information(this, tr("Add Entry"), tr("Select a block first."));
         return;
@@ -348,8 +459,9 @@ void UnicodeMapEditor::addEntry()
     int insertIdx = (ei >= 0) ? ei + 1 : (int)block.entries.size();
 
     UnicodeMapEntry entry;
-    m_undoStack->push(new AddMapEntryCommand(m_font, bi, insertIdx, entry));
-    rebuild();
+    m_model->push(new AddMapEntryCommand(m_font, bi, insertIdx, entry));
+    expandBlock(bi);
+    m_tree->setCurrentIndex(m_model->entryIndex(bi, insertIdx));
     emit mapModified();
 }
 
@@ -358,15 +470,13 @@ void UnicodeMapEditor::removeSelected()
     if (!m_font || !m_undoStack)
         return;
 
-    auto [bi, ei] = selectedBlockEntry();
+    auto [bi, ei] = currentBlockEntry();
     if (bi < 0)
         return;
 
-    if (ei >= 0) {
-        m_undoStack->push(new RemoveMapEntryCommand(m_font, bi, ei));
-    } else {
-        m_undoStack->push(new RemoveMapBlockCommand(m_font, bi));
-    }
-    rebuild();
+    if (ei >= 0)
+        m_model->push(new RemoveMapEntryCommand(m_font, bi, ei));
+    else
+        m_model->push(new RemoveMapBlockCommand(m_font, bi));
     emit mapModified();
 }
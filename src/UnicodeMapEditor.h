@@ -1,10 +1,15 @@
 #pragma once
+#include <QVector>
 #include <QWidget>
 
 class UlfFont;
+class UnicodeMapModel;
 class QUndoStack;
-class QTreeWidget;
-class QTreeWidgetItem;
+class QTreeView;
+class QLabel;
+class QLineEdit;
+class QListWidget;
+class QListWidgetItem;
 
 struct UnicodeMapEntry;
 
@@ -13,12 +18,23 @@ class UnicodeMapEditor : public QWidget {
 public:
     explicit UnicodeMapEditor(QWidget *parent = nullptr);
 
-    void setFont(UlfFont *font) { m_font = font; }
-    void setUndoStack(QUndoStack *stack) { m_undoStack = stack; }
+    void setFont(UlfFont *font);
+    void setUndoStack(QUndoStack *stack);
     void rebuild();
 
+    // (blockIndex, entryIndex) of the current row; entryIndex is -1 on a block
+    std::pair<int,int> currentBlockEntry() const;
+
+    // Edit one entry through the undo stack, refreshing only its row
+    void setEntry(int blockIndex, int entryIndex, const UnicodeMapEntry &entry);
+
+    // Select the entry for a codepoint, adding one (to the block ending just
+    // before it, or as a new block) if it isn't mapped yet
+    void goToCodepoint(uint32_t cp);
+
 signals:
     void entrySelected(int blockIndex, int entryIndex);
+    void blockExpanded(int blockIndex);
     void mapModified();
     void jumpToBaseGlyph(int index);
     void jumpToOverlayGlyph(int index);
@@ -30,17 +46,32 @@ public slots:
 
 private slots:
     void onSelectionChanged();
-    void onItemChanged(QTreeWidgetItem *item, int column);
+    void saveViewState();
+    void restoreViewState();
+    void updateProblemLabel();
+    void selectNextProblem();
+    void updateSearchResults();
+    void activateSearchResult(QListWidgetItem *item);
 
 protected:
     bool eventFilter(QObject *obj, QEvent *event) override;
 
 private:
-    void populateBlock(QTreeWidgetItem *blockItem, int blockIndex);
-    std::pair<int,int> selectedBlockEntry() const;
+    void expandBlock(int blockIndex);
+    void selectEntry(int blockIndex, int entryIndex);
+    int blockInsertPosition(uint32_t startCodepoint) const;
 
     UlfFont *m_font = nullptr;
     QUndoStack *m_undoStack = nullptr;
-    QTreeWidget *m_tree = nullptr;
-    bool m_rebuilding = false;
+    UnicodeMapModel *m_model = nullptr;
+    QTreeView *m_tree = nullptr;
+    QLabel *m_problemLabel = nullptr;
+    QLineEdit *m_searchEdit = nullptr;
+    QListWidget *m_searchResults = nullptr;
+
+    // View state carried across model resets, keyed by block start codepoint
+    QVector<uint32_t> m_savedExpanded;
+    uint32_t m_savedBlockStart = 0;
+    int m_savedBlock = -1;
+    int m_savedEntry = -1;
 };
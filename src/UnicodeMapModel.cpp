@@ -0,0 +1,479 @@
+#include "UnicodeMapModel.h"
+#include "UlfFont.h"
+#include "FontNotifier.h"
+#include "UndoCommands.h"
+#include "UnicodeInfo.h"
+#include <QApplication>
+#include <QColor>
+#include <QStyle>
+#include <QUndoStack>
+
+UnicodeMapModel::UnicodeMapModel(QObject *parent)
+    : QAbstractItemModel(parent)
+{
+    // Slightly larger font for the char column, shared by every row
+    m_charFont.setPointSize(m_charFont.pointSize() + 2);
+}
+
+void UnicodeMapModel::setFont(UlfFont *font)
+{
+    if (m_font && m_font->notifier())
+        disconnect(m_font->notifier(), nullptr, this, nullptr);
+    m_font = font;
+    if (FontNotifier *notifier = m_font ? m_font->notifier() : nullptr) {
+        connect(notifier, &FontNotifier::fontReset, this, &UnicodeMapModel::reload);
+        connect(notifier, &FontNotifier::blockInserted, this, &UnicodeMapModel::blockInserted);
+        connect(notifier, &FontNotifier::blockRemoved, this, &UnicodeMapModel::blockRemoved);
+        connect(notifier, &FontNotifier::blockStartChanged, this, &UnicodeMapModel::blockStartChanged);
+        connect(notifier, &FontNotifier::entryInserted, this, &UnicodeMapModel::entryInserted);
+        connect(notifier, &FontNotifier::entryRemoved, this, &UnicodeMapModel::entryRemoved);
+        connect(notifier, &FontNotifier::entryChanged, this, &UnicodeMapModel::entryChanged);
+    }
+    reload();
+}
+
+void UnicodeMapModel::setUndoStack(QUndoStack *stack)
+{
+    m_undoStack = stack;
+}
+
+std::pair<int,int> UnicodeMapModel::blockEntry(const QModelIndex &index) const
+{
+    if (!index.isValid())
+        return {-1, -1};
+    auto *node = static_cast<BlockNode *>(index.internalPointer());
+    if (!node)
+        return {index.row(), -1};
+    return {node->row, index.row()};
+}
+
+QModelIndex UnicodeMapModel::blockIndex(int blockIndex) const
+{
+    return index(blockIndex, ColCodepoint);
+}
+
+QModelIndex UnicodeMapModel::entryIndex(int blockIndex, int entryIndex, int column) const
+{
+    if (blockIndex < 0 || blockIndex >= (int)m_blocks.size())
+        return QModelIndex();
+    BlockNode *node = m_blocks[blockIndex].get();
+    if (entryIndex < 0 || entryIndex >= node->childCount)
+        return QModelIndex();
+    return createIndex(entryIndex, column, node);
+}
+
+uint32_t UnicodeMapModel::blockStart(int blockIndex) const
+{
+    if (blockIndex < 0 || blockIndex >= (int)m_blocks.size())
+        return 0;
+    return m_blocks[blockIndex]->start;
+}
+
+void UnicodeMapModel::push(QUndoCommand *command)
+{
+    m_undoStack->push(command);
+}
+
+void UnicodeMapModel::setEntry(int blockIndex, int entryIndex, const UnicodeMapEntry &entry)
+{
+    if (!m_font || !m_undoStack)
+        return;
+    push(new EditMapEntryCommand(m_font, blockIndex, entryIndex, entry));
+    emit mapModified();
+}
+
+// --- Notifications ---
+
+void UnicodeMapModel::reload()
+{
+    beginResetModel();
+    m_blocks.clear();
+    m_validator.setFont(m_font);
+    if (m_font) {
+        m_blocks.reserve(m_font->unicodeMap.size());
+        for (int bi = 0; bi < (int)m_font->unicodeMap.size(); ++bi) {
+            m_blocks.push_back(std::make_unique<BlockNode>());
+            m_blocks.back()->start = m_font->unicodeMap[bi].startCodepoint;
+            m_blocks.back()->row = bi;
+            m_blocks.back()->issues = m_validator.issues(bi);
+        }
+    }
+    endResetModel();
+    emit validationChanged();
+}
+
+void UnicodeMapModel::blockInserted(int blockIndex)
+{
+    beginInsertRows(QModelIndex(), blockIndex, blockIndex);
+    m_blocks.insert(m_blocks.begin() + blockIndex, std::make_unique<BlockNode>());
+    m_blocks[blockIndex]->start = m_font->unicodeMap[blockIndex].startCodepoint;
+    renumber(blockIndex);
+    endInsertRows();
+    m_validator.blockInserted(blockIndex);
+    refreshIssues();
+}
+
+void UnicodeMapModel::blockRemoved(int blockIndex)
+{
+    beginRemoveRows(QModelIndex(), blockIndex, blockIndex);
+    m_blocks.erase(m_blocks.begin() + blockIndex);
+    renumber(blockIndex);
+    endRemoveRows();
+    m_validator.blockRemoved(blockIndex);
+    refreshIssues();
+}
+
+void UnicodeMapModel::entryInserted(int blockIndex, int entryIndex)
+{
+    BlockNode *node = m_blocks[blockIndex].get();
+    QModelIndex parent = this->blockIndex(blockIndex);
+    if (node->fetched) {
+        beginInsertRows(parent, entryIndex, entryIndex);
+        ++node->childCount;
+        endInsertRows();
+        shiftedEntries(blockIndex, entryIndex + 1);
+    }
+    // Block label shows the entry count
+    emit dataChanged(parent, parent);
+    m_validator.blockChanged(blockIndex);
+    refreshIssues();
+}
+
+void UnicodeMapModel::entryRemoved(int blockIndex, int entryIndex)
+{
+    BlockNode *node = m_blocks[blockIndex].get();
+    QModelIndex parent = this->blockIndex(blockIndex);
+    if (node->fetched && entryIndex < node->childCount) {
+        beginRemoveRows(parent, entryIndex, entryIndex);
+        --node->childCount;
+        endRemoveRows();
+        shiftedEntries(blockIndex, entryIndex);
+    }
+    emit dataChanged(parent, parent);
+    m_validator.blockChanged(blockIndex);
+    refreshIssues();
+}
+
+void UnicodeMapModel::entryChanged(int blockIndex, int entryIndex)
+{
+    QModelIndex first = this->entryIndex(blockIndex, entryIndex, ColCodepoint);
+    if (first.isValid())
+        emit dataChanged(first, this->entryIndex(blockIndex, entryIndex, ColCount - 1));
+    m_validator.entryChanged(blockIndex, entryIndex);
+    refreshIssues();
+}
+
+void UnicodeMapModel::blockStartChanged(int blockIndex)
+{
+    // Every codepoint in the block moved
+    BlockNode *node = m_blocks[blockIndex].get();
+    node->start = m_font->unicodeMap[blockIndex].startCodepoint;
+    QModelIndex idx = this->blockIndex(blockIndex);
+    emit dataChanged(idx, idx);
+    if (node->childCount > 0) {
+        emit dataChanged(entryIndex(blockIndex, 0),
+                         entryIndex(blockIndex, node->childCount - 1, ColCount - 1));
+    }
+    m_validator.blockChanged(blockIndex);
+    refreshIssues();
+}
+
+void UnicodeMapModel::shiftedEntries(int blockIndex, int from)
+{
+    // Rows from here on now stand for different codepoints
+    int count = m_blocks[blockIndex]->childCount;
+    if (from < count)
+        emit dataChanged(entryIndex(blockIndex, from, ColCodepoint), entryIndex(blockIndex, count - 1, ColChar));
+}
+
+void UnicodeMapModel::renumber(int from)
+{
+    for (int bi = from; bi < (int)m_blocks.size(); ++bi)
+        m_blocks[bi]->row = bi;
+}
+
+void UnicodeMapModel::refreshIssues()
+{
+    // Layout checks can flag or clear blocks other than the one edited
+    for (int bi = 0; bi < (int)m_blocks.size(); ++bi) {
+        unsigned issues = m_validator.issues(bi);
+        if (m_blocks[bi]->issues != issues) {
+            m_blocks[bi]->issues = issues;
+            QModelIndex idx = index(bi, ColCodepoint);
+            emit dataChanged(idx, idx);
+        }
+    }
+    emit validationChanged();
+}
+
+QString UnicodeMapModel::describeIssues(unsigned issues)
+{
+    QStringList lines;
+    if (issues & MapValidator::Overlap)
+        lines << tr("Overlaps another block");
+    if (issues & MapValidator::OutOfOrder)
+        lines << tr("Starts below the previous block");
+    if (issues & MapValidator::OutOfRange)
+        lines << tr("Extends past U+10FFFF");
+    if (issues & MapValidator::BadOverlay)
+        lines << tr("Has entries with an out-of-range overlay index");
+    if (issues & MapValidator::Oversized)
+        lines << tr("More than %1 entries; saved as several blocks").arg(UlfFont::MAX_BLOCK_ENTRIES);
+    if (issues & MapValidator::Empty)
+        lines << tr("Empty; not saved");
+    return lines.join('\n');
+}
+
+int UnicodeMapModel::entryCount(int blockIndex) const
+{
+    if (!m_font || blockIndex < 0 || blockIndex >= (int)m_font->unicodeMap.size())
+        return 0;
+    return (int)m_font->unicodeMap[blockIndex].entries.size();
+}
+
+// --- QAbstractItemModel ---
+
+QModelIndex UnicodeMapModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (row < 0 || column < 0 || column >= ColCount)
+        return QModelIndex();
+    if (!parent.isValid()) {
+        if (row >= (int)m_blocks.size())
+            return QModelIndex();
+        return createIndex(row, column, nullptr);
+    }
+    if (parent.internalPointer() || parent.row() >= (int)m_blocks.size())
+        return QModelIndex();
+    BlockNode *node = m_blocks[parent.row()].get();
+    if (row >= node->childCount)
+        return QModelIndex();
+    return createIndex(row, column, node);
+}
+
+QModelIndex UnicodeMapModel::parent(const QModelIndex &child) const
+{
+    if (!child.isValid())
+        return QModelIndex();
+    auto *node = static_cast<BlockNode *>(child.internalPointer());
+    if (!node)
+        return QModelIndex();
+    return createIndex(node->row, 0, nullptr);
+}
+
+int UnicodeMapModel::rowCount(const QModelIndex &parent) const
+{
+    if (!parent.isValid())
+        return (int)m_blocks.size();
+    if (parent.internalPointer() || parent.column() != 0)
+        return 0;
+    return m_blocks[parent.row()]->childCount;
+}
+
+int UnicodeMapModel::columnCount(const QModelIndex &) const
+{
+    return ColCount;
+}
+
+bool UnicodeMapModel::hasChildren(const QModelIndex &parent) const
+{
+    if (!parent.isValid())
+        return !m_blocks.empty();
+    if (parent.internalPointer() || parent.column() != 0)
+        return false;
+    return entryCount(parent.row()) > 0;
+}
+
+bool UnicodeMapModel::canFetchMore(const QModelIndex &parent) const
+{
+    if (!parent.isValid() || parent.internalPointer() || parent.column() != 0)
+        return false;
+    return !m_blocks[parent.row()]->fetched && entryCount(parent.row()) > 0;
+}
+
+void UnicodeMapModel::fetchMore(const QModelIndex &parent)
+{
+    if (!canFetchMore(parent))
+        return;
+    BlockNode *node = m_blocks[parent.row()].get();
+    int count = entryCount(parent.row());
+    beginInsertRows(parent, 0, count - 1);
+    node->childCount = count;
+    node->fetched = true;
+    endInsertRows();
+}
+
+QVariant UnicodeMapModel::data(const QModelIndex &index, int role) const
+{
+    if (!m_font || !index.isValid())
+        return QVariant();
+
+    auto [bi, ei] = blockEntry(index);
+    if (bi < 0 || bi >= (int)m_font->unicodeMap.size())
+        return QVariant();
+    const auto &block = m_font->unicodeMap[bi];
+
+    if (ei < 0) {
+        if (index.column() != ColCodepoint)
+            return QVariant();
+        unsigned issues = m_validator.issues(bi);
+        // Oversized and empty blocks are handled on save; the rest need fixing
+        bool serious = issues & ~(MapValidator::Oversized | MapValidator::Empty);
+        switch (role) {
+        case Qt::DisplayRole:
+            break;
+        case Qt::DecorationRole:
+            if (!issues)
+                return QVariant();
+            return QApplication::style()->standardIcon(serious
+                ? QStyle::SP_MessageBoxWarning : QStyle::SP_MessageBoxInformation);
+        case Qt::ToolTipRole:
+            if (!issues)
+                return QVariant();
+            return describeIssues(issues);
+        case Qt::ForegroundRole:
+            if (!serious)
+                return QVariant();
+            return QColor(Qt::red);
+        default:
+            return QVariant();
+        }
+        uint32_t endCp = block.startCodepoint + (uint32_t)block.entries.size() - 1;
+        QString label = QStringLiteral("%1–%2 (%3)")
+            .arg(unicodeCodepointStr(block.startCodepoint))
+            .arg(unicodeCodepointStr(endCp))
+            .arg(block.entries.size());
+        QString blockName = unicodeBlockName(block.startCodepoint);
+        if (!blockName.isEmpty())
+            label += "  " + blockName;
+        return label;
+    }
+
+    if (ei >= (int)block.entries.size())
+        return QVariant();
+    const auto &entry = block.entries[ei];
+    uint32_t cp = block.startCodepoint + ei;
+
+    switch (role) {
+    case Qt::DisplayRole:
+    case Qt::EditRole:
+        switch (index.column()) {
+        case ColCodepoint: return unicodeCodepointStr(cp);
+        case ColChar: return unicodeCharStr(cp);
+        case ColBase: return int(entry.baseIndex);
+        case ColOverlay: return int(entry.overlayIndex);
+        default: break;
+        }
+        break;
+    case Qt::FontRole:
+        if (index.column() == ColChar)
+            return m_charFont;
+        break;
+    case Qt::ForegroundRole:
+        if (index.column() == ColOverlay && !m_validator.entryValid(bi, ei))
+            return QColor(Qt::red);
+        break;
+    case Qt::ToolTipRole:
+        if (index.column() == ColOverlay && !m_validator.entryValid(bi, ei))
+            return tr("Overlay index out of range (0-%1)").arg(UlfFont::OVERLAY_COUNT - 1);
+        break;
+    case Qt::CheckStateRole:
+        switch (index.column()) {
+        case ColReverse: return entry.reverse ? Qt::Checked : Qt::Unchecked;
+        case ColHFlip: return entry.hflip ? Qt::Checked : Qt::Unchecked;
+        case ColVFlip: return entry.vflip ? Qt::Checked : Qt::Unchecked;
+        default: break;
+        }
+        break;
+    default:
+        break;
+    }
+    return QVariant();
+}
+
+bool UnicodeMapModel::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+    if (!m_font || !m_undoStack || !index.isValid())
+        return false;
+
+    auto [bi, ei] = blockEntry(index);
+    if (bi < 0 || bi >= (int)m_font->unicodeMap.size() || ei < 0)
+        return false;
+    const auto &block = m_font->unicodeMap[bi];
+    if (ei >= (int)block.entries.size())
+        return false;
+
+    UnicodeMapEntry newEntry = block.entries[ei];
+    bool changed = false;
+
+    if (role == Qt::EditRole) {
+        bool ok;
+        int v = value.toInt(&ok);
+        if (index.column() == ColBase && ok && v >= 0 && v < 256 && v != newEntry.baseIndex) {
+            newEntry.baseIndex = v;
+            changed = true;
+        } else if (index.column() == ColOverlay && ok && v >= 0 && v < 1024 &&
+                   v != (int)newEntry.overlayIndex) {
+            newEntry.overlayIndex = v;
+            changed = true;
+        }
+    } else if (role == Qt::CheckStateRole) {
+        bool v = value.toInt() == Qt::Checked;
+        bool *flag = nullptr;
+        switch (index.column()) {
+        case ColReverse: flag = &newEntry.reverse; break;
+        case ColHFlip: flag = &newEntry.hflip; break;
+        case ColVFlip: flag = &newEntry.vflip; break;
+        default: break;
+        }
+        if (flag && *flag != v) {
+            *flag = v;
+            changed = true;
+        }
+    }
+
+    if (!changed)
+        return false;
+    setEntry(bi, ei, newEntry);
+    return true;
+}
+
+Qt::ItemFlags UnicodeMapModel::flags(const QModelIndex &index) const
+{
+    if (!index.isValid())
+        return Qt::NoItemFlags;
+    Qt::ItemFlags f = Qt::ItemIsSelectable | Qt::ItemIsEnabled;
+    if (!index.internalPointer())
+        return f;
+
+    f |= Qt::ItemNeverHasChildren;
+    switch (index.column()) {
+    case ColBase:
+    case ColOverlay:
+        f |= Qt::ItemIsEditable;
+        break;
+    case ColReverse:
+    case ColHFlip:
+    case ColVFlip:
+        f |= Qt::ItemIsUserCheckable;
+        break;
+    default:
+        break;
+    }
+    return f;
+}
+
+QVariant UnicodeMapModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QVariant();
+    switch (section) {
+    case ColCodepoint: return tr("Codepoint");
+    case ColChar: return tr("Char");
+    case ColBase: return tr("Base");
+    case ColOverlay: return tr("Ovl");
+    case ColReverse: return tr("Rev");
+    case ColHFlip: return tr("HF");
+    case ColVFlip: return tr("VF");
+    default: return QVariant();
+    }
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <QAbstractItemModel>
+#include <QFont>
+#include "MapValidator.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class UlfFont;
+class QUndoStack;
+class QUndoCommand;
+struct UnicodeMapEntry;
+
+// Tree model over UlfFont::unicodeMap: blocks at the top level, their
+// entries as children. Entry rows are only created once a block is expanded.
+class UnicodeMapModel : public QAbstractItemModel {
+    Q_OBJECT
+public:
+    enum Column {
+        ColCodepoint = 0,
+        ColChar,
+        ColBase,
+        ColOverlay,
+        ColReverse,
+        ColHFlip,
+        ColVFlip,
+        ColCount
+    };
+
+    explicit UnicodeMapModel(QObject *parent = nullptr);
+
+    void setFont(UlfFont *font);
+    void setUndoStack(QUndoStack *stack);
+
+    // (blockIndex, entryIndex) of a model index; entryIndex is -1 for blocks
+    std::pair<int,int> blockEntry(const QModelIndex &index) const;
+    QModelIndex blockIndex(int blockIndex) const;
+    QModelIndex entryIndex(int blockIndex, int entryIndex, int column = 0) const;
+    // Start codepoint of a block as of the last notification
+    uint32_t blockStart(int blockIndex) const;
+
+    const MapValidator &validator() const { return m_validator; }
+    static QString describeIssues(unsigned issues);
+
+    // Rows follow the font's FontNotifier, whoever changed the map
+    void push(QUndoCommand *command);
+    void setEntry(int blockIndex, int entryIndex, const UnicodeMapEntry &entry);
+    void reload();
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex &child) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole) override;
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+    QVariant headerData(int section, Qt::Orientation orientation,
+                        int role = Qt::DisplayRole) const override;
+
+signals:
+    void mapModified();
+    void validationChanged();
+
+private:
+    // Mirror of one block's row state; entry indexes point at their block's
+    // node so they stay valid when blocks are inserted or removed
+    struct BlockNode {
+        uint32_t start = 0;
+        int row = 0;
+        int childCount = 0;
+        bool fetched = false;
+        unsigned issues = 0;  // as last shown
+    };
+
+    void blockInserted(int blockIndex);
+    void blockRemoved(int blockIndex);
+    void blockStartChanged(int blockIndex);
+    void entryInserted(int blockIndex, int entryIndex);
+    void entryRemoved(int blockIndex, int entryIndex);
+    void entryChanged(int blockIndex, int entryIndex);
+    void shiftedEntries(int blockIndex, int from);
+    void renumber(int from);
+    void refreshIssues();
+    int entryCount(int blockIndex) const;
+
+    UlfFont *m_font = nullptr;
+    QUndoStack *m_undoStack = nullptr;
+    std::vector<std::unique_ptr<BlockNode>> m_blocks;
+    QFont m_charFont;
+    MapValidator m_validator;
+};
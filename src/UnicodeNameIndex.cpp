@@ -0,0 +1,172 @@
+#include "UnicodeNameIndex.h"
+#include "UnicodeInfo.h"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <string>
+#include <QByteArray>
+#include <QtAlgorithms>
+
+namespace {
+
+// Code point for "U+1F600", "0x1F600" or a bare hex number of at least
+// four digits; -1 otherwise
+int64_t parseCodepoint(const std::string &word)
+{
+    size_t pos = 0;
+    if (word.compare(0, 2, "U+") == 0 || word.compare(0, 2, "0X") == 0)
+        pos = 2;
+    size_t digits = word.size() - pos;
+    if (digits == 0 || digits > 6 || (pos == 0 && digits < 4))
+        return -1;
+    int64_t cp = 0;
+    for (size_t i = pos; i < word.size(); ++i) {
+        char c = word[i];
+        int v = (c >= '0' && c <= '9') ? c - '0' : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+        if (v < 0)
+            return -1;
+        cp = cp * 16 + v;
+    }
+    return cp <= 0x10FFFF ? cp : -1;
+}
+
+} // namespace
+
+const UnicodeNameIndex &UnicodeNameIndex::instance()
+{
+    static const UnicodeNameIndex index;
+    return index;
+}
+
+UnicodeNameIndex::UnicodeNameIndex()
+{
+    m_nameCount = unicodeStoredNameCount();
+    int wordCount = unicodeNameWordCount();
+    m_nameWords.resize(m_nameCount);
+    m_postingStart.assign(wordCount + 1, 0);
+
+    // Count postings per word, then fill them in name order so each list
+    // comes out sorted
+    int words[UNICODE_NAME_BUFFER / 2];
+    for (int name = 0; name < m_nameCount; ++name) {
+        int count = unicodeStoredNameWords(name, words);
+        m_nameWords[name] = (uint8_t)count;
+        for (int i = 0; i < count; ++i)
+            ++m_postingStart[words[i] + 1];
+    }
+    std::partial_sum(m_postingStart.begin(), m_postingStart.end(), m_postingStart.begin());
+
+    m_postings.resize(m_postingStart.back());
+    std::vector<uint32_t> fill(m_postingStart.begin(), m_postingStart.end() - 1);
+    for (int name = 0; name < m_nameCount; ++name) {
+        int count = unicodeStoredNameWords(name, words);
+        for (int i = 0; i < count; ++i)
+            m_postings[fill[words[i]]++] = name;
+    }
+
+    m_sortedWords.resize(wordCount);
+    std::iota(m_sortedWords.begin(), m_sortedWords.end(), 0);
+    std::sort(m_sortedWords.begin(), m_sortedWords.end(), [](int a, int b) {
+        return std::strcmp(unicodeNameWord(a), unicodeNameWord(b)) < 0;
+    });
+}
+
+void UnicodeNameIndex::addPostings(int word, Bits &bits) const
+{
+    for (uint32_t i = m_postingStart[word]; i < m_postingStart[word + 1]; ++i)
+        bits[m_postings[i] >> 6] |= uint64_t(1) << (m_postings[i] & 63);
+}
+
+std::vector<uint32_t> UnicodeNameIndex::search(const QString &query, int limit, int *total) const
+{
+    QByteArray text = query.toUpper().toLatin1();
+    return search(text.constData(), limit, total);
+}
+
+std::vector<uint32_t> UnicodeNameIndex::search(const char *query, int limit, int *total) const
+{
+    std::vector<std::string> queryWords;
+    for (const char *p = query; *p;) {
+        while (*p == ' ')
+            ++p;
+        const char *start = p;
+        while (*p && *p != ' ')
+            ++p;
+        if (p > start)
+            queryWords.emplace_back(start, p);
+    }
+
+    std::vector<uint32_t> result;
+    int64_t hexMatch = queryWords.size() == 1 ? parseCodepoint(queryWords[0]) : -1;
+    if (hexMatch >= 0 && limit > 0)
+        result.push_back((uint32_t)hexMatch);
+    if (total)
+        *total = (int)result.size();
+    if (queryWords.empty())
+        return result;
+
+    // Names matching every query word as a word prefix; also note the word
+    // each query word matches whole, if any, for ranking
+    Bits matches((m_nameCount + 63) / 64, ~uint64_t(0));
+    Bits wordMatches(matches.size());
+    std::vector<int> exactWords;
+    for (const auto &queryWord : queryWords) {
+        std::fill(wordMatches.begin(), wordMatches.end(), 0);
+        auto it = std::lower_bound(m_sortedWords.begin(), m_sortedWords.end(), queryWord,
+            [](int word, const std::string &prefix) {
+                return std::strcmp(unicodeNameWord(word), prefix.c_str()) < 0;
+            });
+        for (; it != m_sortedWords.end(); ++it) {
+            const char *word = unicodeNameWord(*it);
+            if (std::strncmp(word, queryWord.c_str(), queryWord.size()) != 0)
+                break;
+            if (word[queryWord.size()] == 0)
+                exactWords.push_back(*it);
+            addPostings(*it, wordMatches);
+        }
+        for (size_t i = 0; i < matches.size(); ++i)
+            matches[i] &= wordMatches[i];
+    }
+
+    struct Candidate {
+        int name;
+        int exact;
+    };
+    std::vector<Candidate> candidates;
+    for (size_t i = 0; i < matches.size(); ++i) {
+        for (uint64_t bits = matches[i]; bits; bits &= bits - 1) {
+            int name = (int)(i * 64 + qCountTrailingZeroBits(bits));
+            int exact = 0;
+            for (int word : exactWords)
+                exact += std::binary_search(m_postings.begin() + m_postingStart[word],
+                                            m_postings.begin() + m_postingStart[word + 1],
+                                            (uint32_t)name);
+            candidates.push_back({name, exact});
+        }
+    }
+
+    auto better = [this](const Candidate &a, const Candidate &b) {
+        if (a.exact != b.exact)
+            return a.exact > b.exact;
+        if (m_nameWords[a.name] != m_nameWords[b.name])
+            return m_nameWords[a.name] < m_nameWords[b.name];
+        return a.name < b.name;
+    };
+    // The hex match, if it has a name, may be among the candidates too
+    auto isHexMatch = [&](const Candidate &c) {
+        return hexMatch >= 0 && unicodeStoredNameCodepoint(c.name) == (uint32_t)hexMatch;
+    };
+    size_t wanted = std::min(candidates.size(), (size_t)std::max(0, limit - (int)result.size()) + 1);
+    std::partial_sort(candidates.begin(), candidates.begin() + wanted, candidates.end(), better);
+
+    int found = (int)(result.size() + candidates.size());
+    if (hexMatch >= 0)
+        found -= (int)std::count_if(candidates.begin(), candidates.end(), isHexMatch);
+    for (size_t i = 0; i < wanted && (int)result.size() < limit; ++i) {
+        if (!isHexMatch(candidates[i]))
+            result.push_back(unicodeStoredNameCodepoint(candidates[i].name));
+    }
+    if (total)
+        *total = found;
+    return result;
+}
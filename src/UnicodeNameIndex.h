@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <QString>
+
+// Inverted index from name words to the characters whose names use them,
+// for find-as-you-type. Built once, on first use, from the embedded name
+// tables; a query costs a few bitset passes over the matching postings.
+class UnicodeNameIndex {
+public:
+    static const UnicodeNameIndex &instance();
+
+    // Characters whose names contain a word starting with every word of the
+    // query, best first: more query words matched whole, then shorter names,
+    // then lower code points. A "U+hex" / "0xhex" query, or a bare hex
+    // number of four or more digits, also matches that code point first.
+    // total receives the number of matches before the limit.
+    std::vector<uint32_t> search(const QString &query, int limit, int *total = nullptr) const;
+    // Same, for an uppercase Latin-1 query
+    std::vector<uint32_t> search(const char *query, int limit, int *total = nullptr) const;
+
+private:
+    UnicodeNameIndex();
+
+    using Bits = std::vector<uint64_t>;
+    void addPostings(int word, Bits &bits) const;
+
+    int m_nameCount = 0;
+    std::vector<int> m_sortedWords;       // word ids in strcmp order
+    std::vector<uint32_t> m_postingStart; // per word id, into m_postings
+    std::vector<uint32_t> m_postings;     // name indexes, ascending per word
+    std::vector<uint8_t> m_nameWords;     // word count per name
+};
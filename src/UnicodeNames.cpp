@@ -1,28 +1,259 @@
 #include "UnicodeInfo.h"
-#include <unicode/uchar.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
 
 #ifdef Q_OS_MACOS
 #include <CoreText/CoreText.h>
 #include <CoreFoundation/CoreFoundation.h>
 #endif
 
-QString unicodeCharName(uint32_t cp)
+namespace {
+
+// Code points named by rule rather than stored
+struct AlgorithmicNames {
+    enum Kind : uint8_t { Hex, Hangul };
+    uint32_t first;
+    uint32_t last;
+    Kind kind;
+    const char *prefix;  // Hex: name is prefix + code point in hex
+};
+
+// Consecutive code points with stored names
+struct NameRun {
+    uint32_t first;
+    uint32_t last;
+    uint32_t nameIndex;  // name of `first`; the rest follow in order
+};
+
+#include "UnicodeTables.inc"
+
+static_assert(MAX_NAME_LENGTH < UNICODE_NAME_BUFFER, "UNICODE_NAME_BUFFER too small");
+
+// Entry of a table sorted by `first` whose [first, last] holds cp
+template <typename T, size_t N>
+const T *findRange(const T (&table)[N], uint32_t cp)
 {
-    char buf[256];
-    UErrorCode err = U_ZERO_ERROR;
+    const T *it = std::upper_bound(table, table + N, cp,
+        [](uint32_t value, const T &range) { return value < range.first; });
+    if (it == table)
+        return nullptr;
+    --it;
+    return cp <= it->last ? it : nullptr;
+}
 
-    // Try the standard Unicode character name first
-    int len = u_charName((UChar32)cp, U_UNICODE_CHAR_NAME, buf, sizeof(buf), &err);
-    if (U_SUCCESS(err) && len > 0)
-        return QString::fromLatin1(buf, len);
+class NameWriter {
+public:
+    NameWriter(char *buf, int size) : m_buf(buf), m_size(size) {}
 
-    // Fall back to extended name (covers control chars, PUA, etc.)
-    err = U_ZERO_ERROR;
-    len = u_charName((UChar32)cp, U_EXTENDED_CHAR_NAME, buf, sizeof(buf), &err);
-    if (U_SUCCESS(err) && len > 0)
-        return QString::fromLatin1(buf, len);
+    void append(const char *text, int length)
+    {
+        if (m_length + length >= m_size) {
+            m_overflow = true;
+            return;
+        }
+        std::memcpy(m_buf + m_length, text, length);
+        m_length += length;
+    }
+    void append(const char *text) { append(text, (int)std::strlen(text)); }
 
-    return QString();
+    int finish()
+    {
+        if (m_overflow || m_length >= m_size) {
+            if (m_size > 0)
+                m_buf[0] = 0;
+            return 0;
+        }
+        m_buf[m_length] = 0;
+        return m_length;
+    }
+
+private:
+    char *m_buf;
+    int m_size;
+    int m_length = 0;
+    bool m_overflow = false;
+};
+
+void appendHangulName(NameWriter &out, uint32_t cp)
+{
+    static const char *const leading[] = {
+        "G", "GG", "N", "D", "DD", "R", "M", "B", "BB", "S", "SS", "", "J", "JJ",
+        "C", "K", "T", "P", "H"};
+    static const char *const vowels[] = {
+        "A", "AE", "YA", "YAE", "EO", "E", "YEO", "YE", "O", "WA", "WAE", "OE",
+        "YO", "U", "WEO", "WE", "WI", "YU", "EU", "YI", "I"};
+    static const char *const trailing[] = {
+        "", "G", "GG", "GS", "N", "NJ", "NH", "D", "L", "LG", "LM", "LB", "LS",
+        "LT", "LP", "LH", "M", "B", "BS", "S", "SS", "NG", "J", "C", "K", "T",
+        "P", "H"};
+    constexpr int V_COUNT = 21, T_COUNT = 28;
+
+    uint32_t s = cp - 0xAC00;
+    out.append("HANGUL SYLLABLE ");
+    out.append(leading[s / (V_COUNT * T_COUNT)]);
+    out.append(vowels[(s / T_COUNT) % V_COUNT]);
+    out.append(trailing[s % T_COUNT]);
+}
+
+// Start of a stored name: its token count, then the tokens
+const uint8_t *storedName(uint32_t nameIndex)
+{
+    const uint8_t *p = kNameTokens + kNameGroupOffsets[nameIndex / NAME_GROUP];
+    for (uint32_t i = nameIndex % NAME_GROUP; i > 0; --i)
+        p += 1 + *p;
+    return p;
+}
+
+// Calls fn(wordId) for each word of a stored name
+template <typename Fn>
+void forEachWord(uint32_t nameIndex, Fn fn)
+{
+    const uint8_t *p = storedName(nameIndex);
+    const uint8_t *end = p + 1 + *p;
+    ++p;
+    while (p < end) {
+        int token = *p++;
+        if (token >= ONE_BYTE_TOKENS)
+            token = ONE_BYTE_TOKENS + ((token - ONE_BYTE_TOKENS) << 8 | *p++);
+        fn(token);
+    }
+}
+
+void appendStoredName(NameWriter &out, uint32_t nameIndex)
+{
+    bool first = true;
+    forEachWord(nameIndex, [&](int word) {
+        if (!first)
+            out.append(" ", 1);
+        out.append(kWordChars + kWordOffsets[word]);
+        first = false;
+    });
+}
+
+bool isNoncharacter(uint32_t cp)
+{
+    return (cp >= 0xFDD0 && cp <= 0xFDEF) || (cp & 0xFFFE) == 0xFFFE;
+}
+
+} // namespace
+
+const UnicodeBlock *unicodeBlock(uint32_t cp)
+{
+    return findRange(kBlocks, cp);
+}
+
+int unicodeBlockCount()
+{
+    return (int)std::size(kBlocks);
+}
+
+const UnicodeBlock &unicodeBlockAt(int index)
+{
+    return kBlocks[index];
+}
+
+UnicodeCategory unicodeCategory(uint32_t cp)
+{
+    if (cp > 0x10FFFF)
+        return UnicodeCategory::Cn;
+    auto it = std::upper_bound(std::begin(kCategoryRuns), std::end(kCategoryRuns), cp << 5 | 0x1F);
+    return static_cast<UnicodeCategory>(it[-1] & 0x1F);
+}
+
+const char *unicodeCategoryCode(UnicodeCategory category)
+{
+    static const char *const codes[] = {
+        "Lu", "Ll", "Lt", "Lm", "Lo", "Mn", "Mc", "Me", "Nd", "Nl", "No",
+        "Pc", "Pd", "Ps", "Pe", "Pi", "Pf", "Po", "Sm", "Sc", "Sk", "So",
+        "Zs", "Zl", "Zp", "Cc", "Cf", "Cs", "Co", "Cn"};
+    return codes[static_cast<int>(category)];
+}
+
+const char *unicodeCategoryName(UnicodeCategory category)
+{
+    static const char *const names[] = {
+        "Uppercase Letter", "Lowercase Letter", "Titlecase Letter", "Modifier Letter",
+        "Other Letter", "Nonspacing Mark", "Spacing Mark", "Enclosing Mark",
+        "Decimal Number", "Letter Number", "Other Number", "Connector Punctuation",
+        "Dash Punctuation", "Open Punctuation", "Close Punctuation", "Initial Punctuation",
+        "Final Punctuation", "Other Punctuation", "Math Symbol", "Currency Symbol",
+        "Modifier Symbol", "Other Symbol", "Space Separator", "Line Separator",
+        "Paragraph Separator", "Control", "Format", "Surrogate", "Private Use",
+        "Unassigned"};
+    return names[static_cast<int>(category)];
+}
+
+const char *unicodeVersion()
+{
+    return kUnicodeVersion;
+}
+
+int unicodeNameWordCount()
+{
+    return (int)std::size(kWordOffsets);
+}
+
+const char *unicodeNameWord(int word)
+{
+    return kWordChars + kWordOffsets[word];
+}
+
+int unicodeStoredNameCount()
+{
+    const NameRun &last = kNameRuns[std::size(kNameRuns) - 1];
+    return (int)(last.nameIndex + (last.last - last.first) + 1);
+}
+
+uint32_t unicodeStoredNameCodepoint(int nameIndex)
+{
+    const NameRun *run = std::upper_bound(std::begin(kNameRuns), std::end(kNameRuns), (uint32_t)nameIndex,
+        [](uint32_t index, const NameRun &r) { return index < r.nameIndex; });
+    --run;
+    return run->first + ((uint32_t)nameIndex - run->nameIndex);
+}
+
+int unicodeStoredNameWords(int nameIndex, int *words)
+{
+    int count = 0;
+    forEachWord((uint32_t)nameIndex, [&](int word) { words[count++] = word; });
+    return count;
+}
+
+int unicodeCharName(uint32_t cp, char *buf, int size)
+{
+    NameWriter out(buf, size);
+    char hex[16];
+
+    if (const NameRun *run = findRange(kNameRuns, cp)) {
+        appendStoredName(out, run->nameIndex + (cp - run->first));
+    } else if (const AlgorithmicNames *range = findRange(kAlgorithmicNames, cp)) {
+        if (range->kind == AlgorithmicNames::Hangul) {
+            appendHangulName(out, cp);
+        } else {
+            out.append(range->prefix);
+            out.append(hex, std::snprintf(hex, sizeof(hex), "%04X", (unsigned)cp));
+        }
+    } else {
+        // Same labels as ICU's extended names
+        const char *label = "unassigned";
+        switch (unicodeCategory(cp)) {
+        case UnicodeCategory::Cc: label = "control"; break;
+        case UnicodeCategory::Co: label = "private-use"; break;
+        case UnicodeCategory::Cs: label = cp < 0xDC00 ? "lead-surrogate" : "trail-surrogate"; break;
+        default:
+            if (isNoncharacter(cp))
+                label = "noncharacter";
+            break;
+        }
+        if (cp > 0x10FFFF)
+            return out.finish();
+        out.append("<");
+        out.append(label);
+        out.append(hex, std::snprintf(hex, sizeof(hex), "-%04X>", (unsigned)cp));
+    }
+    return out.finish();
 }
 
 QString fontForCodepoint(uint32_t cp)
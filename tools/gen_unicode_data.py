@@ -0,0 +1,244 @@
+#!/usr/bin/env python3
+"""Generate the Unicode tables compiled into x16unifontedit.
+
+Block ranges come from the vendored data/Blocks.txt, character names and
+general categories from the vendored data/UnicodeData.txt; both must be
+from the same UCD release. The output is a C++ fragment included by
+src/UnicodeNames.cpp, which holds the lookup code.
+
+Names are stored as sequences of word tokens (most frequent words get one
+byte, the rest two), length-prefixed, with a byte offset for every
+NAME_GROUP-th name. Names that are just a prefix plus the code point in hex
+(CJK ideographs and the like) and Hangul syllables are generated at lookup
+time instead of stored.
+"""
+
+import argparse
+import collections
+import re
+import sys
+
+NAME_GROUP = 32
+ONE_BYTE_TOKENS = 0xC0
+MAX_TOKENS = ONE_BYTE_TOKENS + (0x100 - ONE_BYTE_TOKENS) * 0x100
+
+CATEGORIES = [
+    "Lu", "Ll", "Lt", "Lm", "Lo", "Mn", "Mc", "Me", "Nd", "Nl", "No",
+    "Pc", "Pd", "Ps", "Pe", "Pi", "Pf", "Po", "Sm", "Sc", "Sk", "So",
+    "Zs", "Zl", "Zp", "Cc", "Cf", "Cs", "Co", "Cn",
+]
+
+# Names of the code points in UnicodeData.txt's <..., First>/<..., Last>
+# ranges, by range label prefix; Hangul syllables are handled separately
+RANGE_NAME_PREFIXES = {
+    "CJK Ideograph": "CJK UNIFIED IDEOGRAPH-",
+    "Tangut Ideograph": "TANGUT IDEOGRAPH-",
+}
+
+ALGORITHMIC_HEX = 0
+ALGORITHMIC_HANGUL = 1
+
+
+def read_blocks(path):
+    blocks = []
+    version = None
+    with open(path, encoding="utf-8") as f:
+        for line in f:
+            if version is None:
+                m = re.match(r"#\s*Blocks-([\d.]+)\.txt", line)
+                if m:
+                    version = m.group(1)
+            line = line.split("#", 1)[0].strip()
+            if not line:
+                continue
+            span, name = (part.strip() for part in line.split(";"))
+            first, last = (int(cp, 16) for cp in span.split(".."))
+            blocks.append((first, last, name))
+    blocks.sort()
+    return blocks, version
+
+
+def range_name(label, cp):
+    if label == "Hangul Syllable":
+        return "HANGUL SYLLABLE "  # spelled out at lookup time
+    for prefix, name in RANGE_NAME_PREFIXES.items():
+        if label.startswith(prefix):
+            return "%s%04X" % (name, cp)
+    return None  # surrogates and private use
+
+
+def read_unicode_data(path):
+    """Return {code point: (name or None, general category)}."""
+    chars = {}
+    first = None
+    with open(path, encoding="utf-8") as f:
+        for line in f:
+            fields = line.rstrip("\n").split(";")
+            if len(fields) < 3:
+                continue
+            cp, name, category = int(fields[0], 16), fields[1], fields[2]
+            if name.endswith(", First>"):
+                first = cp
+                continue
+            if name.endswith(", Last>"):
+                label = name[1:-len(", Last>")]
+                for c in range(first, cp + 1):
+                    chars[c] = (range_name(label, c), category)
+                continue
+            chars[cp] = (None if name.startswith("<") else name, category)
+    return chars
+
+
+def collect_names(chars):
+    """Split names into stored ones and algorithmic ranges."""
+    stored = {}
+    algorithmic = []  # [first, last, kind, prefix]
+    for cp in sorted(chars):
+        name = chars[cp][0]
+        if name is None:
+            continue
+
+        if name.startswith("HANGUL SYLLABLE "):
+            kind, prefix = ALGORITHMIC_HANGUL, ""
+        else:
+            hex_cp = "%04X" % cp
+            if name.endswith("-" + hex_cp):
+                kind, prefix = ALGORITHMIC_HEX, name[:-len(hex_cp)]
+            else:
+                stored[cp] = name
+                continue
+
+        last = algorithmic[-1] if algorithmic else None
+        if last and last[1] == cp - 1 and last[2] == kind and last[3] == prefix:
+            last[1] = cp
+        else:
+            algorithmic.append([cp, cp, kind, prefix])
+    return stored, algorithmic
+
+
+def category_runs(chars):
+    runs = []
+    previous = None
+    for cp in range(0x110000):
+        category = CATEGORIES.index(chars[cp][1] if cp in chars else "Cn")
+        if category != previous:
+            runs.append((cp, category))
+            previous = category
+    return runs
+
+
+def c_string(text):
+    return '"' + text.replace("\\", "\\\\").replace('"', '\\"') + '"'
+
+
+def emit_array(out, decl, values, per_line=16):
+    out.append("%s = {" % decl)
+    for i in range(0, len(values), per_line):
+        out.append("    " + ",".join(str(v) for v in values[i:i + per_line]) + ",")
+    out.append("};")
+
+
+def generate(blocks, chars, version):
+    stored, algorithmic = collect_names(chars)
+
+    # Token ids by descending frequency, ties broken alphabetically so the
+    # output is stable
+    counts = collections.Counter(w for name in stored.values() for w in name.split(" "))
+    words = sorted(counts, key=lambda w: (-counts[w], w))
+    if len(words) > MAX_TOKENS:
+        sys.exit("gen_unicode_data: %d distinct name words, at most %d fit"
+                 % (len(words), MAX_TOKENS))
+    token_of = {w: i for i, w in enumerate(words)}
+
+    word_chars = []
+    word_offsets = []
+    for word in words:
+        word_offsets.append(len(word_chars))
+        word_chars.extend(word.encode("ascii"))
+        word_chars.append(0)
+
+    # Runs of consecutive stored names: (first, last, index of first name)
+    name_runs = []
+    name_bytes = []
+    group_offsets = []
+    for index, cp in enumerate(sorted(stored)):
+        if name_runs and name_runs[-1][1] == cp - 1:
+            name_runs[-1][1] = cp
+        else:
+            name_runs.append([cp, cp, index])
+        if index % NAME_GROUP == 0:
+            group_offsets.append(len(name_bytes))
+        encoded = []
+        for word in stored[cp].split(" "):
+            token = token_of[word]
+            if token < ONE_BYTE_TOKENS:
+                encoded.append(token)
+            else:
+                token -= ONE_BYTE_TOKENS
+                encoded.extend((ONE_BYTE_TOKENS + (token >> 8), token & 0xFF))
+        assert len(encoded) < 256
+        name_bytes.append(len(encoded))
+        name_bytes.extend(encoded)
+
+    runs = category_runs(chars)
+
+    out = [
+        "// Generated by tools/gen_unicode_data.py — do not edit.",
+        "// Unicode %s: data/Blocks.txt, data/UnicodeData.txt." % version,
+        "",
+        "static const char kUnicodeVersion[] = %s;" % c_string(version),
+        "",
+        "static const UnicodeBlock kBlocks[] = {",
+    ]
+    for first, last, name in blocks:
+        out.append("    {0x%04X, 0x%04X, %s}," % (first, last, c_string(name)))
+    out.append("};")
+    out.append("")
+
+    out.append("// first code point << 5 | UnicodeCategory, one per run")
+    emit_array(out, "static const uint32_t kCategoryRuns[]",
+               ["0x%X" % (cp << 5 | category) for cp, category in runs], 8)
+    out.append("")
+
+    out.append("static const AlgorithmicNames kAlgorithmicNames[] = {")
+    for first, last, kind, prefix in algorithmic:
+        out.append("    {0x%04X, 0x%04X, %s, %s}," % (
+            first, last, "AlgorithmicNames::Hangul" if kind == ALGORITHMIC_HANGUL
+            else "AlgorithmicNames::Hex", c_string(prefix)))
+    out.append("};")
+    out.append("")
+
+    out.append("static constexpr int NAME_GROUP = %d;" % NAME_GROUP)
+    out.append("static constexpr int ONE_BYTE_TOKENS = 0x%X;" % ONE_BYTE_TOKENS)
+    out.append("static constexpr int MAX_NAME_LENGTH = %d;"
+               % max(len(n) for n in stored.values()))
+    out.append("")
+    emit_array(out, "static const NameRun kNameRuns[]",
+               ["{0x%04X,0x%04X,%d}" % tuple(run) for run in name_runs], 4)
+    emit_array(out, "static const uint32_t kNameGroupOffsets[]", group_offsets)
+    emit_array(out, "static const uint8_t kNameTokens[]", name_bytes, 24)
+    emit_array(out, "static const uint32_t kWordOffsets[]", word_offsets)
+    emit_array(out, "static const char kWordChars[]", word_chars, 24)
+    out.append("")
+    return "\n".join(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--blocks", required=True, help="path to Blocks.txt")
+    parser.add_argument("--unicode-data", required=True, help="path to UnicodeData.txt")
+    parser.add_argument("-o", "--output", required=True, help="generated .inc file")
+    args = parser.parse_args()
+
+    blocks, version = read_blocks(args.blocks)
+    if version is None:
+        sys.exit("gen_unicode_data: no version line in %s" % args.blocks)
+    chars = read_unicode_data(args.unicode_data)
+
+    text = generate(blocks, chars, version)
+    with open(args.output, "w", encoding="utf-8", newline="\n") as f:
+        f.write(text)
+
+
+if __name__ == "__main__":
+    main()
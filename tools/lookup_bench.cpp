@@ -0,0 +1,74 @@
+// Times UlfFont::findEntry against the linear front-to-back block scan it
+// replaced, on a random map with overlapping blocks, and checks that both
+// return the same entry for every lookup.
+//
+//   lookup_bench [blocks] [lookups]
+#include "UlfFont.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+static const UnicodeMapEntry *linearFind(const UlfFont &font, uint32_t codepoint)
+{
+    for (const auto &block : font.unicodeMap) {
+        if (codepoint >= block.startCodepoint
+            && codepoint < block.startCodepoint + block.entries.size())
+            return &block.entries[codepoint - block.startCodepoint];
+    }
+    return nullptr;
+}
+
+template <typename Find>
+static double timeLookups(const std::vector<uint32_t> &codepoints, Find find,
+                          std::vector<const UnicodeMapEntry *> &results)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < codepoints.size(); ++i)
+        results[i] = find(codepoints[i]);
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    int blockCount = argc > 1 ? std::atoi(argv[1]) : 400;
+    int lookupCount = argc > 2 ? std::atoi(argv[2]) : 1400000;
+
+    // Fixed seed, so runs are comparable
+    std::mt19937 rng(1);
+    constexpr uint32_t SPAN = 0x30000;
+    UlfFont font;
+    font.clear();
+    for (int i = 0; i < blockCount; ++i) {
+        UnicodeMapBlock block;
+        block.startCodepoint = rng() % SPAN;
+        block.entries.resize(1 + rng() % UlfFont::MAX_BLOCK_ENTRIES);
+        font.insertBlock(i, block);
+    }
+
+    std::vector<uint32_t> codepoints(lookupCount);
+    for (auto &cp : codepoints)
+        cp = rng() % (SPAN + UlfFont::MAX_BLOCK_ENTRIES);
+
+    std::vector<const UnicodeMapEntry *> linear(lookupCount), indexed(lookupCount);
+    double linearMs = timeLookups(codepoints, [&font](uint32_t cp) { return linearFind(font, cp); }, linear);
+    double indexedMs = timeLookups(codepoints, [&font](uint32_t cp) { return font.findEntry(cp); }, indexed);
+
+    int mismatches = 0;
+    int hits = 0;
+    for (int i = 0; i < lookupCount; ++i) {
+        mismatches += linear[i] != indexed[i];
+        hits += indexed[i] != nullptr;
+    }
+
+    std::printf("%d blocks, %d lookups (%d mapped)\n", blockCount, lookupCount, hits);
+    std::printf("linear scan: %8.1f ms\n", linearMs);
+    std::printf("span index:  %8.1f ms\n", indexedMs);
+    if (mismatches) {
+        std::printf("%d lookups differ\n", mismatches);
+        return 1;
+    }
+    return 0;
+}